@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Load test for the backend: keep-alive and pipelined requests over a mix of
+routes, optionally while a long scan runs. Standard library only.
+
+    python3 load.py --connections 16 --requests 2000
+    python3 load.py --pipeline 8 --directory /usr/include
+    python3 load.py --background-scan /usr    # /files latency during a scan
+
+Every connection is kept alive for all of its requests; with --pipeline N it
+writes N requests at once before reading the N responses. The default route
+mix hits cheap handlers and unknown routes, so the numbers are dominated by
+the connection handling and the route table, not the disk. Latency is also
+reported per route, so /files can be watched on its own while a scan runs.
+"""
+
+import argparse
+import socket
+import threading
+import time
+import urllib.parse
+
+
+class Connection:
+    """One keep-alive connection that reads HTTP/1.1 responses in order."""
+
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buffer = b""
+
+    def close(self):
+        self.sock.close()
+
+    def _fill(self):
+        chunk = self.sock.recv(65536)
+        if not chunk:
+            raise ConnectionError("server closed the connection")
+        self.buffer += chunk
+
+    def _line(self):
+        while b"\r\n" not in self.buffer:
+            self._fill()
+        line, self.buffer = self.buffer.split(b"\r\n", 1)
+        return line
+
+    def _take(self, count):
+        while len(self.buffer) < count:
+            self._fill()
+        data, self.buffer = self.buffer[:count], self.buffer[count:]
+        return data
+
+    def read_response(self):
+        """Returns (status, body); 100 Continue responses are skipped."""
+        while True:
+            status = int(self._line().split(b" ", 2)[1])
+            headers = {}
+            while True:
+                line = self._line()
+                if not line:
+                    break
+                name, _, value = line.partition(b":")
+                headers[name.strip().lower()] = value.strip().lower()
+            if status != 100:
+                break
+
+        if headers.get(b"transfer-encoding") == b"chunked":
+            body = b""
+            while True:
+                size = int(self._line().split(b";")[0], 16)
+                if size == 0:
+                    while self._line():
+                        pass
+                    return status, body
+                body += self._take(size)
+                self._take(2)
+        return status, self._take(int(headers.get(b"content-length", b"0")))
+
+
+def request_bytes(host, port, target):
+    return ("GET %s HTTP/1.1\r\nHost: %s:%d\r\n\r\n" % (target, host, port)).encode()
+
+
+def percentile(sorted_values, share):
+    if not sorted_values:
+        return 0.0
+    return sorted_values[min(len(sorted_values) - 1, int(share * len(sorted_values)))]
+
+
+def route_of(target):
+    return target.split("?", 1)[0]
+
+
+def run_client(args, targets, offset, results):
+    latencies, by_route, statuses, errors = results
+    try:
+        connection = Connection(args.host, args.port)
+    except OSError as error:
+        errors.append(str(error))
+        return
+    sent = 0
+    try:
+        while sent < args.requests:
+            batch = [targets[(offset + sent + i) % len(targets)]
+                     for i in range(min(args.pipeline, args.requests - sent))]
+            start = time.perf_counter()
+            connection.sock.sendall(b"".join(request_bytes(args.host, args.port, t) for t in batch))
+            for _ in batch:
+                status, _ = connection.read_response()
+                statuses[status] = statuses.get(status, 0) + 1
+            # Each response of a pipelined batch waited for the whole batch
+            elapsed = time.perf_counter() - start
+            latencies.extend([elapsed] * len(batch))
+            for target in batch:
+                by_route.setdefault(route_of(target), []).append(elapsed)
+            sent += len(batch)
+    except (OSError, ValueError, IndexError) as error:
+        errors.append(str(error))
+    finally:
+        connection.close()
+
+
+def run_background_scan(args, stop, scans):
+    target = "/scan-cleanup?" + urllib.parse.urlencode(
+        {"directory": args.background_scan, "fileType": "log", "beforeTimestamp": 2000000000})
+    while not stop.is_set():
+        try:
+            connection = Connection(args.host, args.port)
+            connection.sock.sendall(request_bytes(args.host, args.port, target))
+            connection.read_response()
+            connection.close()
+            scans.append(1)
+        except OSError:
+            time.sleep(0.1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--connections", type=int, default=8, help="concurrent keep-alive connections")
+    parser.add_argument("--requests", type=int, default=1000, help="requests per connection")
+    parser.add_argument("--pipeline", type=int, default=1, help="requests written per round trip")
+    parser.add_argument("--directory", default=".", help="directory listed by /files")
+    parser.add_argument("--target", action="append", help="request target to use instead of the default mix")
+    parser.add_argument("--background-scan", metavar="DIR", help="keep a /scan-cleanup of DIR running meanwhile")
+    args = parser.parse_args()
+
+    directory = urllib.parse.quote(args.directory, safe="")
+    targets = args.target or [
+        "/files?directory=" + directory,
+        "/drives",
+        "/jobs?id=0",
+        "/not-a-route",
+        "/directories?path=" + directory,
+    ]
+
+    stop = threading.Event()
+    scans = []
+    if args.background_scan:
+        threading.Thread(target=run_background_scan, args=(args, stop, scans), daemon=True).start()
+        time.sleep(0.5)  # let the scan get going
+
+    # Per connection, merged once they are done
+    results = [([], {}, {}, []) for _ in range(args.connections)]
+    clients = [threading.Thread(target=run_client, args=(args, targets, i, results[i]))
+               for i in range(args.connections)]
+    start = time.perf_counter()
+    for client in clients:
+        client.start()
+    for client in clients:
+        client.join()
+    elapsed = time.perf_counter() - start
+    stop.set()
+
+    latencies, by_route, statuses, errors = [], {}, {}, []
+    for client_latencies, client_by_route, client_statuses, client_errors in results:
+        latencies.extend(client_latencies)
+        for route, values in client_by_route.items():
+            by_route.setdefault(route, []).extend(values)
+        for status, count in client_statuses.items():
+            statuses[status] = statuses.get(status, 0) + count
+        errors.extend(client_errors)
+    latencies.sort()
+    print("%d requests over %d connections (pipeline %d) in %.2f s: %.0f requests/s" %
+          (len(latencies), args.connections, args.pipeline, elapsed, len(latencies) / elapsed if elapsed else 0))
+    print("latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f" %
+          tuple(1000 * percentile(latencies, share) for share in (0.5, 0.9, 0.99, 1.0)))
+    for route, values in sorted(by_route.items()):
+        values.sort()
+        print("  %-20s p50 %.2f  p99 %.2f  (%d requests)" %
+              (route, 1000 * percentile(values, 0.5), 1000 * percentile(values, 0.99), len(values)))
+    print("statuses: " + ", ".join("%d x%d" % item for item in sorted(statuses.items())))
+    if args.background_scan:
+        files = sorted(by_route.get("/files", []))
+        print("/files during the scan: p50 %.2f ms  p99 %.2f ms" %
+              (1000 * percentile(files, 0.5), 1000 * percentile(files, 0.99)))
+        print("background scans completed meanwhile: %d" % len(scans))
+    if errors:
+        print("%d connections failed, first: %s" % (len(errors), errors[0]))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,114 @@
+// Microbenchmark for the request hot path that does not touch the disk:
+// the route table lookup and the query/JSON parameter parsing of /files and
+// /scan-cleanup. Reports nanoseconds and heap allocations per request.
+//
+//   g++ -std=c++17 -O2 -Wall -Wextra route_bench.cpp -o route_bench && ./route_bench
+
+#include "../src/request_params.hpp"
+#include "../src/routes.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+
+// ============================================================================
+// Allocation Counting
+// ============================================================================
+
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// ============================================================================
+// Baseline
+// ============================================================================
+
+// The baseline the table replaced: one comparison per route, in order
+static RouteId linearLookup(std::string_view method, std::string_view path) {
+    for (const auto& route : kRoutes) {
+        if (route.method == method && route.path == path) return route.id;
+    }
+    return RouteId::NotFound;
+}
+
+// ============================================================================
+// Driver
+// ============================================================================
+
+struct Sample {
+    std::string_view method;
+    std::string_view target;
+};
+
+// A mix of hits, including the last route of the list, and misses
+constexpr Sample kSamples[] = {
+    {"GET", "/files?directory=%2Fhome%2Fuser%2FDownloads"},
+    {"GET", "/scan-cleanup?directory=%2Fhome%2Fuser&fileType=log&beforeTimestamp=1700000000"},
+    {"GET", "/drives"},
+    {"POST", "/plans"},
+    {"GET", "/jobs/result?id=42"},
+    {"GET", "/favicon.ico"},
+    {"PUT", "/files"},
+};
+
+constexpr size_t kIterations = 2000000;
+
+template <typename Body>
+static void measure(const char* name, Body body) {
+    size_t allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    size_t sink = 0;
+    for (size_t i = 0; i < kIterations; i++) sink += body(kSamples[i % (sizeof(kSamples) / sizeof(kSamples[0]))]);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / kIterations;
+    double perRequest = (double)(allocations.load() - allocationsBefore) / kIterations;
+    std::printf("%-28s %8.1f ns/request  %6.3f allocations/request  (checksum %zu)\n", name, ns, perRequest, sink);
+}
+
+static std::string_view pathOf(std::string_view target) {
+    return target.substr(0, target.find('?'));
+}
+
+int main() {
+    measure("route table", [](const Sample& s) {
+        RouteId id = RouteId::NotFound;
+        kRouteTable.find(s.method, pathOf(s.target), id);
+        return (size_t)id;
+    });
+    measure("linear route scan", [](const Sample& s) { return (size_t)linearLookup(s.method, pathOf(s.target)); });
+
+    // Storage reused across requests, the way a connection reuses it
+    std::string directory, fileType;
+    long long before = 0;
+    measure("query parameters", [&](const Sample& s) {
+        queryParam(s.target, "directory", directory);
+        queryParam(s.target, "fileType", fileType);
+        queryParam(s.target, "beforeTimestamp", before);
+        return directory.size() + fileType.size() + (size_t)before;
+    });
+
+    const std::string body = R"({"directory":"/home/user/Downloads","fileType":"tmp","beforeTimestamp":1700000000})";
+    measure("JSON body parameters", [&](const Sample&) {
+        jsonStringValue(body, "directory", directory);
+        jsonStringValue(body, "fileType", fileType);
+        jsonNumberValue(body, "beforeTimestamp", before);
+        return directory.size() + fileType.size() + (size_t)before;
+    });
+    return 0;
+}
@@ -1,6 +1,18 @@
 import { useState, useEffect } from 'react';
 import './App.css';
 
+// Rows of a compact listing (compact=1) are [directory, name, size]; a path is
+// put together from the directory table only for the rows that are shown
+const joinPath = (parent, name, separator) =>
+  parent.endsWith(separator) || parent.endsWith('/') ? parent + name : parent + separator + name;
+
+const directoryPath = (listing, index) => {
+  const [parent, name] = listing.directories[index];
+  return parent < 0 ? name : joinPath(directoryPath(listing, parent), name, listing.separator);
+};
+
+const compactPath = (listing, row) => joinPath(directoryPath(listing, row[0]), row[1], listing.separator);
+
 function App() {
   const [files, setFiles] = useState([]);
   const [directory, setDirectory] = useState('C:\\');
@@ -10,13 +22,30 @@ function App() {
   const [cleanupConfig, setCleanupConfig] = useState({
     fileType: '',
     daysOld: 30,
+    filter: '',
     scanDirectory: 'C:\\'
   });
   const [scanResults, setScanResults] = useState(null);
   const [isScanning, setIsScanning] = useState(false);
   const [isDeleting, setIsDeleting] = useState(false);
+  const [scanProgress, setScanProgress] = useState(null);
+  const [activeScanId, setActiveScanId] = useState(null);
 
   const API_URL = 'http://localhost:8080';
+  const WS_URL = API_URL.replace(/^http/, 'ws');
+
+  // Listens for progress frames of one scan; returns a function that stops listening
+  const watchScanProgress = (progressId) => {
+    const socket = new WebSocket(`${WS_URL}/progress?id=${encodeURIComponent(progressId)}`);
+    socket.onmessage = (event) => {
+      const frame = JSON.parse(event.data);
+      if (frame.type === 'progress') setScanProgress(frame);
+    };
+    return () => {
+      socket.close();
+      setScanProgress(null);
+    };
+  };
 
   const fetchFiles = async () => {
     try {
@@ -64,6 +93,10 @@ function App() {
     setIsScanning(true);
     setScanResults(null);
 
+    const progressId = `${Date.now()}-${Math.random().toString(36).slice(2)}`;
+    const stopWatching = watchScanProgress(progressId);
+    setActiveScanId(progressId);
+
     try {
       const normalizedDirectory = cleanupConfig.scanDirectory.replace(/\\/g, '/');
       const daysAgoTimestamp = Math.floor(Date.now() / 1000) - (cleanupConfig.daysOld * 24 * 60 * 60);
@@ -75,8 +108,9 @@ function App() {
         date: new Date(daysAgoTimestamp * 1000).toLocaleString()
       });
       
+      const filterParam = cleanupConfig.filter.trim() ? `&filter=${encodeURIComponent(cleanupConfig.filter.trim())}` : '';
       const response = await fetch(
-        `${API_URL}/scan-cleanup?directory=${encodeURIComponent(normalizedDirectory)}&fileType=${encodeURIComponent(cleanupConfig.fileType)}&beforeTimestamp=${daysAgoTimestamp}`
+        `${API_URL}/scan-cleanup?directory=${encodeURIComponent(normalizedDirectory)}&fileType=${encodeURIComponent(cleanupConfig.fileType)}&beforeTimestamp=${daysAgoTimestamp}${filterParam}&progressId=${encodeURIComponent(progressId)}&compact=1`
       );
       
       const data = await response.json();
@@ -91,10 +125,22 @@ function App() {
       console.error('Error scanning for cleanup:', error);
       alert('Failed to scan directory. Make sure the C++ server is running.');
     } finally {
+      stopWatching();
+      setActiveScanId(null);
       setIsScanning(false);
     }
   };
 
+  // The server ends the scan at its next directory and still answers with what it found
+  const cancelScan = async () => {
+    if (!activeScanId) return;
+    try {
+      await fetch(`${API_URL}/cancel?id=${encodeURIComponent(activeScanId)}`, { method: 'POST' });
+    } catch (error) {
+      console.error('Error cancelling scan:', error);
+    }
+  };
+
   const executeCleanup = async () => {
     if (!scanResults || scanResults.count === 0) return;
 
@@ -108,20 +154,38 @@ function App() {
       const normalizedDirectory = cleanupConfig.scanDirectory.replace(/\\/g, '/');
       const daysAgoTimestamp = Math.floor(Date.now() / 1000) - (cleanupConfig.daysOld * 24 * 60 * 60);
       
-      const response = await fetch(`${API_URL}/cleanup`, {
+      // Deletion runs as a background job; poll it instead of holding the request open
+      const submitResponse = await fetch(`${API_URL}/jobs/cleanup`, {
         method: 'POST',
         headers: { 'Content-Type': 'application/json' },
+        // With a scan token the server deletes exactly the files shown above, skipping any that changed since
         body: JSON.stringify({
           directory: normalizedDirectory,
           fileType: cleanupConfig.fileType,
-          beforeTimestamp: daysAgoTimestamp
+          beforeTimestamp: daysAgoTimestamp,
+          filter: cleanupConfig.filter.trim(),
+          scanToken: scanResults.scanToken
         })
       });
-      
+      const submitted = await submitResponse.json();
+      if (!submitted.success) {
+        alert(submitted.message || 'Failed to start cleanup');
+        return;
+      }
+
+      let status = submitted.status;
+      while (status !== 'finished') {
+        await new Promise((resolve) => setTimeout(resolve, 500));
+        const statusResponse = await fetch(`${API_URL}/jobs?id=${submitted.jobId}`);
+        if (!statusResponse.ok) throw new Error('Cleanup job was lost');
+        status = (await statusResponse.json()).status;
+      }
+
+      const response = await fetch(`${API_URL}/jobs/result?id=${submitted.jobId}`);
       const data = await response.json();
       
       if (data.success) {
-        alert(`Successfully deleted ${data.count} file(s)\nTotal space freed: ${formatSize(data.totalSize || 0)}`);
+        alert(`${data.message}\nTotal space freed: ${formatSize(data.totalSize || 0)}`);
         setScanResults(null);
         setShowCleanupModal(false);
         fetchFiles();
@@ -298,6 +362,20 @@ function App() {
               </small>
             </div>
 
+            <div className="form-group">
+              <label className="form-label">Additional filter (optional):</label>
+              <input 
+                type="text"
+                className="form-input"
+                value={cleanupConfig.filter}
+                onChange={(e) => setCleanupConfig({...cleanupConfig, filter: e.target.value})}
+                placeholder="size>100M !path:*/keep/*"
+              />
+              <small className="form-hint">
+                Space-separated terms that must all match: name:, path:, size&gt;, size&lt;, atime&lt;, owner:
+              </small>
+            </div>
+
             <div className="scan-button-group">
               <button 
                 onClick={scanForCleanup}
@@ -306,13 +384,30 @@ function App() {
               >
                 {isScanning ? 'Scanning...' : 'Scan for Files'}
               </button>
+              {isScanning && (
+                <button onClick={cancelScan} className="scan-button cancel-button">
+                  Cancel
+                </button>
+              )}
             </div>
 
+            {isScanning && scanProgress && (
+              <small className="form-hint scan-progress">
+                {scanProgress.filesScanned.toLocaleString()} files scanned, {scanProgress.filesMatched.toLocaleString()} matching ({formatSize(scanProgress.bytesMatched)})
+                {scanProgress.etaMs !== null && `, about ${Math.ceil(scanProgress.etaMs / 1000)}s left`}
+                <br />
+                {scanProgress.currentDirectory}
+              </small>
+            )}
+
             {scanResults && (
               <div className='results'>
                 <h3>Scan Results:</h3>
                 <p><strong>Files found:</strong> {scanResults.count}</p>
                 <p><strong>Total size:</strong> {formatSize(scanResults.totalSize || 0)}</p>
+                {scanResults.truncated && (
+                  <p className="form-hint">The scan was stopped early, so only part of the folder was checked.</p>
+                )}
                 
                 {scanResults.files && scanResults.files.length > 0 && (
                   <div>
@@ -321,7 +416,7 @@ function App() {
                     </p>
                     <ul className="file-list">
                       {scanResults.files.slice(0, 10).map((file, idx) => (
-                        <li key={idx} className="file-list-item">{file}</li>
+                        <li key={idx} className="file-list-item">{compactPath(scanResults, file)}</li>
                       ))}
                       {scanResults.files.length > 10 && (
                         <li className="file-list-more">
@@ -0,0 +1,171 @@
+#ifndef DECLUTTER_CANCELLATION_HPP
+#define DECLUTTER_CANCELLATION_HPP
+
+#include "http_server.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// ============================================================================
+// Cooperative Cancellation (cancel requests, client disconnects, deadlines)
+// ============================================================================
+//
+// Long walks poll a CancellationToken once per directory and stop at the
+// next check after it fires. Nothing is interrupted mid-file, so whatever
+// was produced up to that point is consistent and can be returned.
+
+// Directories are the natural checkpoint, but a single directory can hold
+// millions of entries, so walks also check after this many entries
+constexpr size_t kCancellationCheckInterval = 1024;
+
+// Stalled: the client stopped reading a shared walk's results for so long
+// that the other readers went on without it
+enum class CancelReason { None, Cancelled, Disconnected, Deadline, Stalled };
+
+inline const char* cancelReasonName(CancelReason reason) {
+    switch (reason) {
+        case CancelReason::Cancelled: return "cancelled";
+        case CancelReason::Disconnected: return "disconnected";
+        case CancelReason::Deadline: return "deadline";
+        case CancelReason::Stalled: return "stalled";
+        default: return "none";
+    }
+}
+
+/**
+ * @brief Tells a running walk to stop. Fires when cancel() is called, when
+ * the watched client connection closes, or when the deadline passes; the
+ * first of these is kept as the reason. Thread-safe.
+ */
+class CancellationToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void cancel(CancelReason why = CancelReason::Cancelled) {
+        int expected = (int)CancelReason::None;
+        state.compare_exchange_strong(expected, (int)why, std::memory_order_acq_rel);
+    }
+
+    /**
+     * @brief Stops the work once `client` has disconnected. Set before the
+     * token is shared.
+     */
+    void watch(const std::shared_ptr<Connection>& client) {
+        connection = client;
+        watching = true;
+    }
+
+    void setDeadline(std::chrono::milliseconds fromNow) {
+        deadlineTicks.store((Clock::now() + fromNow).time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Lets the remaining work run to completion however long it takes
+     * (explicit cancellation and disconnects still apply)
+     */
+    void clearDeadline() {
+        deadlineTicks.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief True once the work should stop. Cheap enough to call for every
+     * directory: an atomic load, plus a clock read when a deadline is set.
+     */
+    bool stopRequested() {
+        if (state.load(std::memory_order_acquire) != (int)CancelReason::None) return true;
+        if (watching) {
+            auto client = connection.lock();
+            if (!client || !client->isOpen()) cancel(CancelReason::Disconnected);
+        }
+        long long deadline = deadlineTicks.load(std::memory_order_relaxed);
+        if (deadline != 0 && Clock::now().time_since_epoch().count() >= deadline) cancel(CancelReason::Deadline);
+        return state.load(std::memory_order_acquire) != (int)CancelReason::None;
+    }
+
+    CancelReason reason() const {
+        return (CancelReason)state.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<int> state{(int)CancelReason::None};
+    std::atomic<long long> deadlineTicks{0};  // Clock ticks, 0 = no deadline
+    std::weak_ptr<Connection> connection;
+    bool watching = false;
+};
+
+/**
+ * @brief Running walks addressable by the id the client started them with,
+ * so a later request can cancel them. Several walks may share one id.
+ */
+class CancellationRegistry {
+public:
+    /**
+     * @brief Keeps a token registered for as long as it lives
+     */
+    class Registration {
+    public:
+        Registration() = default;
+        Registration(CancellationRegistry* registry, std::string id, CancellationToken* token)
+            : registry(registry), id(std::move(id)), token(token) {}
+
+        ~Registration() {
+            if (registry) registry->remove(id, token);
+        }
+
+        Registration(Registration&& other) noexcept
+            : registry(other.registry), id(std::move(other.id)), token(other.token) {
+            other.registry = nullptr;
+        }
+
+        Registration(const Registration&) = delete;
+        Registration& operator=(const Registration&) = delete;
+        Registration& operator=(Registration&&) = delete;
+
+    private:
+        CancellationRegistry* registry = nullptr;
+        std::string id;
+        CancellationToken* token = nullptr;
+    };
+
+    /**
+     * @brief Registers a token under `id`; an empty id registers nothing
+     */
+    Registration add(const std::string& id, CancellationToken& token) {
+        if (id.empty()) return Registration();
+        std::lock_guard<std::mutex> lock(mutex);
+        tokens.emplace(id, &token);
+        return Registration(this, id, &token);
+    }
+
+    /**
+     * @brief Cancels every walk registered under `id`; returns how many
+     */
+    size_t cancel(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto range = tokens.equal_range(id);
+        size_t count = 0;
+        for (auto it = range.first; it != range.second; ++it, ++count) it->second->cancel();
+        return count;
+    }
+
+private:
+    void remove(const std::string& id, CancellationToken* token) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto range = tokens.equal_range(id);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == token) {
+                tokens.erase(it);
+                return;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::unordered_multimap<std::string, CancellationToken*> tokens;
+};
+
+#endif // DECLUTTER_CANCELLATION_HPP
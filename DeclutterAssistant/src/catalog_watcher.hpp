@@ -0,0 +1,316 @@
+#ifndef DECLUTTER_CATALOG_WATCHER_HPP
+#define DECLUTTER_CATALOG_WATCHER_HPP
+
+#include "file_catalog.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Live Catalog Updates (inotify)
+// ============================================================================
+//
+// Every directory of a cataloged root gets an inotify watch. Creating,
+// deleting, moving or writing a file marks its directory as changed; a
+// moment later the changed directories are read again and the catalog is
+// republished. Once the first full check of a root has watched all of its
+// directories the root is live: scans and listings below it are answered
+// from memory, seconds fresh, without touching the disk.
+//
+// Each root's watches are spread over a few inotify instances by top-level
+// subdirectory. When the kernel queue of one overflows (IN_Q_OVERFLOW),
+// events were lost somewhere in its share of the tree, so only those
+// subtrees are checked again, the same way a request refreshes them.
+//
+// Elsewhere there is no watcher and cataloged roots are refreshed by the
+// requests themselves.
+
+// inotify instances per root; an overflow rechecks one of these shares
+constexpr size_t kWatchPartitions = 4;
+
+// Changes are collected for this long before the catalog is updated, so a
+// burst of writes costs one update
+constexpr std::chrono::milliseconds kWatchBatchDelay(500);
+
+// The watching thread wakes up this often to apply changes and to notice
+// that it should stop
+constexpr std::chrono::milliseconds kWatchPollInterval(250);
+
+#ifdef __linux__
+
+class CatalogWatcher {
+public:
+    explicit CatalogWatcher(FileCatalog& catalog) : catalog(catalog) {}
+
+    ~CatalogWatcher() {
+        stop();
+    }
+
+    CatalogWatcher(const CatalogWatcher&) = delete;
+    CatalogWatcher& operator=(const CatalogWatcher&) = delete;
+
+    /**
+     * @brief Starts following every cataloged root. Call before the first
+     * walk. False if inotify is not available.
+     */
+    bool start() {
+        for (size_t index = 0; index < catalog.rootCount(); index++) {
+            std::unique_ptr<WatchedRoot> root(new WatchedRoot());
+            root->path = catalog.rootPath(index);
+            for (Partition& partition : root->partitions) {
+                partition.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                if (partition.fd < 0) {
+                    std::cerr << "inotify unavailable (" << errno << "); catalogs are refreshed per request" << std::endl;
+                    closeAll(*root);
+                    for (auto& started : roots) closeAll(*started);
+                    roots.clear();
+                    return false;
+                }
+            }
+            roots.push_back(std::move(root));
+        }
+        if (roots.empty()) return false;
+
+        catalog.setDirectoryHook([this](size_t root, const std::filesystem::path& directory) { watch(root, directory); });
+        running = true;
+        thread = std::thread([this] { run(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        thread.join();
+        for (auto& root : roots) closeAll(*root);
+    }
+
+private:
+    static constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+                                           IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+    struct Partition {
+        int fd = -1;
+        std::unordered_map<int, std::string> directories;  // by watch descriptor
+        bool overflowed = false;
+    };
+
+    struct WatchedRoot {
+        std::string path;
+        Partition partitions[kWatchPartitions];
+        std::unordered_set<std::string> changed;
+        std::chrono::steady_clock::time_point firstChange;
+        bool failed = false;  // out of watches; refreshed per request instead
+    };
+
+    /**
+     * @brief Watches a directory a refresh is about to read, so nothing
+     * that changes after the read goes unnoticed. Runs on refreshing threads.
+     */
+    void watch(size_t index, const std::filesystem::path& directory) {
+        WatchedRoot& root = *roots[index];
+        std::lock_guard<std::mutex> lock(mutex);
+        if (root.failed) return;
+        Partition& partition = root.partitions[partitionOf(root, directory.native())];
+        int wd = inotify_add_watch(partition.fd, directory.c_str(), kWatchMask);
+        if (wd >= 0) {
+            // A directory moved within the root keeps its watch descriptor
+            partition.directories[wd] = directory.native();
+        } else if (errno == ENOSPC || errno == ENOMEM) {
+            std::cerr << "Out of inotify watches for " << root.path
+                      << " (see fs.inotify.max_user_watches); refreshing it per request" << std::endl;
+            root.failed = true;
+        }
+    }
+
+    /**
+     * @brief Which instance watches a directory: the root itself goes to the
+     * first, everything else by its top-level subdirectory
+     */
+    static size_t partitionOf(const WatchedRoot& root, const std::string& directory) {
+        if (directory.size() <= root.path.size()) return 0;
+        size_t start = root.path.size();
+        if (directory[start] == '/') start++;
+        size_t end = directory.find('/', start);
+        return std::hash<std::string>()(directory.substr(start, end - start)) % kWatchPartitions;
+    }
+
+    void run() {
+        // Checking every root once watches all of its directories; from then
+        // on the events keep it current
+        for (size_t index = 0; index < roots.size() && running; index++) {
+            CatalogTargets targets;
+            targets.subtrees.push_back(roots[index]->path);
+            bool updated = catalog.update(index, std::move(targets));
+            if (updated && !failed(index)) {
+                catalog.setLive(index, true);
+                std::cout << "Following changes below " << roots[index]->path << std::endl;
+            }
+        }
+
+        std::vector<pollfd> fds;
+        for (auto& root : roots) {
+            for (Partition& partition : root->partitions) fds.push_back(pollfd{partition.fd, POLLIN, 0});
+        }
+        std::unique_ptr<char[]> buffer(new char[kDirectoryReadBuffer]);
+        while (running) {
+            if (::poll(fds.data(), fds.size(), (int)kWatchPollInterval.count()) > 0) {
+                for (size_t index = 0; index < roots.size(); index++) {
+                    for (size_t p = 0; p < kWatchPartitions; p++) {
+                        if (fds[index * kWatchPartitions + p].revents & POLLIN) drain(*roots[index], p, buffer.get());
+                    }
+                }
+            }
+            for (size_t index = 0; index < roots.size(); index++) apply(index);
+        }
+    }
+
+    /**
+     * @brief Reads a partition's pending events into its root's changes
+     */
+    void drain(WatchedRoot& root, size_t p, char* buffer) {
+        Partition& partition = root.partitions[p];
+        while (true) {
+            ssize_t length = ::read(partition.fd, buffer, kDirectoryReadBuffer);
+            if (length <= 0) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    partition.overflowed = true;
+                    continue;
+                }
+                auto it = partition.directories.find(event->wd);
+                if (it == partition.directories.end()) continue;
+                if (event->mask & IN_IGNORED) {
+                    partition.directories.erase(it);
+                    continue;
+                }
+                if (event->mask & IN_MOVE_SELF) {
+                    // Its old parent reports the move; if it stayed in the
+                    // root, reading the new parent watches it again
+                    std::string moved = it->second;
+                    unwatchSubtree(root, moved);
+                    continue;
+                }
+                if (root.changed.empty()) root.firstChange = std::chrono::steady_clock::now();
+                root.changed.insert(it->second);
+            }
+        }
+    }
+
+    /**
+     * @brief Drops the watches of a directory and everything below it; the
+     * paths they were registered under no longer hold. Call with mutex held.
+     */
+    void unwatchSubtree(WatchedRoot& root, const std::string& directory) {
+        for (Partition& partition : root.partitions) {
+            for (auto it = partition.directories.begin(); it != partition.directories.end();) {
+                const std::string& path = it->second;
+                bool below = path.size() > directory.size() && path[directory.size()] == '/' &&
+                             path.compare(0, directory.size(), directory) == 0;
+                if (path == directory || below) {
+                    inotify_rm_watch(partition.fd, it->first);
+                    it = partition.directories.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Updates a root's catalog once its changes have settled, or
+     * right away after an overflow
+     */
+    void apply(size_t index) {
+        WatchedRoot& root = *roots[index];
+        CatalogTargets targets;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool overflowed = false;
+            for (Partition& partition : root.partitions) overflowed = overflowed || partition.overflowed;
+            if (root.failed) {
+                catalog.setLive(index, false);
+                root.changed.clear();
+                return;
+            }
+            if (!overflowed && (root.changed.empty() ||
+                                std::chrono::steady_clock::now() - root.firstChange < kWatchBatchDelay)) {
+                return;
+            }
+            for (size_t p = 0; p < kWatchPartitions; p++) {
+                Partition& partition = root.partitions[p];
+                if (!partition.overflowed) continue;
+                partition.overflowed = false;
+                std::cerr << "inotify queue overflow below " << root.path << "; checking the affected subtrees"
+                          << std::endl;
+                // Events about the root's own entries may be gone too
+                if (p == 0) root.changed.insert(root.path);
+                for (const auto& watched : partition.directories) {
+                    if (isTopLevel(root, watched.second)) targets.subtrees.push_back(watched.second);
+                }
+            }
+            targets.changed.swap(root.changed);
+        }
+        catalog.update(index, std::move(targets));
+    }
+
+    static bool isTopLevel(const WatchedRoot& root, const std::string& directory) {
+        if (directory.size() <= root.path.size()) return false;
+        size_t start = root.path.size() + (directory[root.path.size()] == '/' ? 1 : 0);
+        return directory.find('/', start) == std::string::npos;
+    }
+
+    bool failed(size_t index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return roots[index]->failed;
+    }
+
+    static void closeAll(WatchedRoot& root) {
+        for (Partition& partition : root.partitions) {
+            if (partition.fd >= 0) ::close(partition.fd);
+            partition.fd = -1;
+        }
+    }
+
+    FileCatalog& catalog;
+    std::vector<std::unique_ptr<WatchedRoot>> roots;  // by root index, fixed once started
+    std::mutex mutex;                                 // guards the roots' watches and changes
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
+
+#else
+
+class CatalogWatcher {
+public:
+    explicit CatalogWatcher(FileCatalog&) {}
+
+    bool start() {
+        return false;
+    }
+
+    void stop() {}
+};
+
+#endif
+
+#endif // DECLUTTER_CATALOG_WATCHER_HPP
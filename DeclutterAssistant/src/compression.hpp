@@ -0,0 +1,221 @@
+#ifndef DECLUTTER_COMPRESSION_HPP
+#define DECLUTTER_COMPRESSION_HPP
+
+// ============================================================================
+// Response Compression (Accept-Encoding negotiation, gzip / zstd encoders)
+// ============================================================================
+//
+// The encoders need external libraries, so each is opt-in at build time:
+//   -DDECLUTTER_WITH_ZLIB -lz      gzip
+//   -DDECLUTTER_WITH_ZSTD -lzstd   zstd
+// Without either, negotiation always picks identity and nothing changes.
+
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef DECLUTTER_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DECLUTTER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Bodies smaller than this are sent uncompressed; the framing overhead and
+// CPU time are not worth it for a few hundred bytes
+constexpr size_t kCompressionMinBytes = 1024;
+
+constexpr int kGzipLevel = 5;
+constexpr int kZstdLevel = 3;
+
+enum class ContentEncoding { Identity, Gzip, Zstd };
+
+inline const char* contentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Zstd: return "zstd";
+        default: return "identity";
+    }
+}
+
+inline bool equalsIgnoreCase(std::string_view text, std::string_view lower) {
+    if (text.size() != lower.size()) return false;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (tolower((unsigned char)text[i]) != lower[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Picks the best encoding this build supports from an Accept-Encoding
+ * header, honouring q-values and "*". Ties go to zstd, which is faster.
+ */
+inline ContentEncoding negotiateEncoding(std::string_view acceptEncoding) {
+    double gzipQ = -1, zstdQ = -1, anyQ = -1;
+
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == std::string_view::npos) end = acceptEncoding.size();
+        std::string_view item = acceptEncoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semicolon = item.find(';');
+        std::string_view name = item.substr(0, semicolon);
+        if (semicolon != std::string_view::npos) {
+            size_t qPos = item.find("q=", semicolon);
+            if (qPos != std::string_view::npos) {
+                // strtod needs a terminated string; q-values are short
+                char text[8] = {};
+                item.substr(qPos + 2, sizeof(text) - 1).copy(text, sizeof(text) - 1);
+                q = strtod(text, nullptr);
+            }
+        }
+        while (!name.empty() && (name.front() == ' ' || name.front() == '\t')) name.remove_prefix(1);
+        while (!name.empty() && (name.back() == ' ' || name.back() == '\t')) name.remove_suffix(1);
+
+        if (equalsIgnoreCase(name, "gzip") || equalsIgnoreCase(name, "x-gzip")) gzipQ = q;
+        else if (equalsIgnoreCase(name, "zstd")) zstdQ = q;
+        else if (name == "*") anyQ = q;
+    }
+
+    if (gzipQ < 0) gzipQ = anyQ;
+    if (zstdQ < 0) zstdQ = anyQ;
+
+#ifndef DECLUTTER_WITH_ZLIB
+    gzipQ = 0;
+#endif
+#ifndef DECLUTTER_WITH_ZSTD
+    zstdQ = 0;
+#endif
+
+    if (zstdQ > 0 && zstdQ >= gzipQ) return ContentEncoding::Zstd;
+    if (gzipQ > 0) return ContentEncoding::Gzip;
+    return ContentEncoding::Identity;
+}
+
+/**
+ * @brief Incremental compressor. Output is appended to `out`; with flush set
+ * everything written so far becomes decodable, so each chunk of a streamed
+ * response can be shown by the client as soon as it arrives.
+ */
+class StreamEncoder {
+public:
+    virtual ~StreamEncoder() = default;
+    virtual bool write(const char* data, size_t size, bool flush, std::string& out) = 0;
+    virtual bool finish(std::string& out) = 0;
+};
+
+#ifdef DECLUTTER_WITH_ZLIB
+class GzipEncoder : public StreamEncoder {
+public:
+    GzipEncoder() {
+        // windowBits 15 + 16 selects the gzip wrapper
+        ok = deflateInit2(&stream, kGzipLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~GzipEncoder() override {
+        if (ok) deflateEnd(&stream);
+    }
+
+    bool write(const char* data, size_t size, bool flush, std::string& out) override {
+        return run(data, size, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH, out);
+    }
+
+    bool finish(std::string& out) override {
+        return run(nullptr, 0, Z_FINISH, out);
+    }
+
+private:
+    bool run(const char* data, size_t size, int mode, std::string& out) {
+        if (!ok) return false;
+        stream.next_in = (Bytef*)data;
+        stream.avail_in = (uInt)size;
+        while (true) {
+            size_t used = out.size();
+            size_t room = deflateBound(&stream, stream.avail_in) + 64;
+            out.resize(used + room);
+            stream.next_out = (Bytef*)&out[used];
+            stream.avail_out = (uInt)room;
+            int status = deflate(&stream, mode);
+            out.resize(used + room - stream.avail_out);
+            if (status == Z_STREAM_ERROR) return ok = false;
+            if (mode == Z_FINISH ? status == Z_STREAM_END : stream.avail_out != 0) return true;
+        }
+    }
+
+    z_stream stream{};
+    bool ok = false;
+};
+#endif
+
+#ifdef DECLUTTER_WITH_ZSTD
+class ZstdEncoder : public StreamEncoder {
+public:
+    ZstdEncoder() : context(ZSTD_createCCtx()) {
+        if (context) ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, kZstdLevel);
+    }
+
+    ~ZstdEncoder() override {
+        ZSTD_freeCCtx(context);
+    }
+
+    bool write(const char* data, size_t size, bool flush, std::string& out) override {
+        return run(data, size, flush ? ZSTD_e_flush : ZSTD_e_continue, out);
+    }
+
+    bool finish(std::string& out) override {
+        return run(nullptr, 0, ZSTD_e_end, out);
+    }
+
+private:
+    bool run(const char* data, size_t size, ZSTD_EndDirective mode, std::string& out) {
+        if (!context) return false;
+        ZSTD_inBuffer input{data, size, 0};
+        while (true) {
+            size_t used = out.size();
+            size_t room = ZSTD_CStreamOutSize();
+            out.resize(used + room);
+            ZSTD_outBuffer output{&out[used], room, 0};
+            size_t remaining = ZSTD_compressStream2(context, &output, &input, mode);
+            out.resize(used + output.pos);
+            if (ZSTD_isError(remaining)) return false;
+            // continue: done once the input is consumed; flush/end: once
+            // nothing is left inside the encoder either
+            bool done = mode == ZSTD_e_continue ? input.pos == input.size : remaining == 0;
+            if (done) return true;
+        }
+    }
+
+    ZSTD_CCtx* context;
+};
+#endif
+
+inline std::unique_ptr<StreamEncoder> createEncoder(ContentEncoding encoding) {
+    switch (encoding) {
+#ifdef DECLUTTER_WITH_ZLIB
+        case ContentEncoding::Gzip: return std::unique_ptr<StreamEncoder>(new GzipEncoder());
+#endif
+#ifdef DECLUTTER_WITH_ZSTD
+        case ContentEncoding::Zstd: return std::unique_ptr<StreamEncoder>(new ZstdEncoder());
+#endif
+        default: return nullptr;
+    }
+}
+
+/**
+ * @brief Compresses a complete body. Returns false if the encoding is not
+ * available, in which case the body should be sent as is.
+ */
+inline bool compressBuffer(ContentEncoding encoding, const std::string& in, std::string& out) {
+    std::unique_ptr<StreamEncoder> encoder = createEncoder(encoding);
+    if (!encoder) return false;
+    out.clear();
+    out.reserve(in.size() / 4 + 64);
+    return encoder->write(in.data(), in.size(), false, out) && encoder->finish(out);
+}
+
+#endif // DECLUTTER_COMPRESSION_HPP
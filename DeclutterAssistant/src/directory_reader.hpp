@@ -0,0 +1,523 @@
+#ifndef DECLUTTER_DIRECTORY_READER_HPP
+#define DECLUTTER_DIRECTORY_READER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Directory Reading (getdents64 + statx on Linux, std::filesystem elsewhere)
+// ============================================================================
+//
+// A walk needs the name and type of every entry, but the size or times of
+// only a few. std::filesystem answers every question with a stat of the
+// full path, so a scan used to cost several path lookups per file. On Linux
+// the directory is read with large getdents64 calls, whose d_type tells
+// files from directories without any stat, and the entries that are still
+// interesting get a single statx relative to the open directory, asking
+// only for the fields wanted. Elsewhere the std::filesystem entry is used,
+// which on Windows already carries size and times from the directory read.
+
+// Bytes requested per getdents64 call; a few hundred entries per syscall
+constexpr size_t kDirectoryReadBuffer = 64 * 1024;
+
+// Fields an EntryStatus request can ask for
+enum StatField : unsigned {
+    kStatSize = 1,
+    kStatModified = 2,
+    kStatAccessed = 4,  // not available on Windows
+    kStatChanged = 8,   // inode change time; not available on Windows
+    kStatOwner = 16,    // not available on Windows
+    kStatInode = 32,    // not available on Windows
+};
+
+constexpr unsigned kStatTimes = kStatModified | kStatAccessed | kStatChanged;
+
+/**
+ * @brief What status() found out about an entry; only the requested fields
+ * are set
+ */
+struct EntryStatus {
+    uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+    std::filesystem::file_time_type accessed;
+    std::filesystem::file_time_type changed;
+    unsigned long owner = 0;  // uid
+    uint64_t inode = 0;
+};
+
+/**
+ * @brief Whether status() can provide these fields on this platform
+ */
+inline bool statFieldsSupported(unsigned fields) {
+#ifdef _WIN32
+    return (fields & (kStatAccessed | kStatChanged | kStatOwner | kStatInode)) == 0;
+#else
+    (void)fields;
+    return true;
+#endif
+}
+
+/**
+ * @brief A Unix time as a file_time_type, to compare file times against
+ */
+inline std::filesystem::file_time_type fileTimeFromTimeT(time_t seconds);
+
+namespace detail {
+
+/**
+ * @brief The portable way, for when the fast one cannot be used
+ */
+inline bool statPortable(const std::filesystem::path& path, unsigned fields, EntryStatus& out) {
+    std::error_code ec;
+    if (fields & kStatSize) {
+        out.size = std::filesystem::file_size(path, ec);
+        if (ec) return false;
+    }
+    if (fields & kStatModified) {
+        out.modified = std::filesystem::last_write_time(path, ec);
+        if (ec) return false;
+    }
+    if (fields & (kStatAccessed | kStatChanged | kStatOwner | kStatInode)) {
+#ifdef _WIN32
+        return false;
+#else
+        struct stat status;
+        if (::stat(path.c_str(), &status) != 0) return false;
+        out.accessed = fileTimeFromTimeT(status.st_atime);
+        out.changed = fileTimeFromTimeT(status.st_ctime);
+        out.owner = status.st_uid;
+        out.inode = status.st_ino;
+#endif
+    }
+    return true;
+}
+
+}  // namespace detail
+
+#ifdef __linux__
+
+/**
+ * @brief An entry kept past the reader's next read, e.g. to sort a directory
+ */
+struct SavedEntry {
+    std::string name;
+    unsigned char type;
+};
+
+namespace detail {
+
+/**
+ * @brief Offset of file_time_type's epoch from the Unix epoch. It differs
+ * between standard libraries and C++17 has no way to ask, so it is measured
+ * once by comparing one file's time read both ways. False if that failed.
+ */
+inline bool fileClockOffset(std::filesystem::file_time_type::duration& offset) {
+    struct Calibration {
+        bool valid = false;
+        std::filesystem::file_time_type::duration offset{};
+    };
+    static const Calibration calibration = [] {
+        Calibration result;
+        for (const char* probe : {"/proc/self/exe", "/"}) {
+            struct stat before, after;
+            std::error_code ec;
+            if (::stat(probe, &before) != 0) continue;
+            auto viaLibrary = std::filesystem::last_write_time(probe, ec);
+            if (ec || ::stat(probe, &after) != 0) continue;
+            if (before.st_mtim.tv_sec != after.st_mtim.tv_sec || before.st_mtim.tv_nsec != after.st_mtim.tv_nsec) {
+                continue;  // changed while we looked
+            }
+            auto unixTime = std::chrono::duration_cast<std::filesystem::file_time_type::duration>(
+                std::chrono::seconds(before.st_mtim.tv_sec) + std::chrono::nanoseconds(before.st_mtim.tv_nsec));
+            result.offset = viaLibrary.time_since_epoch() - unixTime;
+            result.valid = true;
+            break;
+        }
+        return result;
+    }();
+    offset = calibration.offset;
+    return calibration.valid;
+}
+
+inline std::filesystem::file_time_type toFileTime(long long seconds, long long nanoseconds,
+                                                  std::filesystem::file_time_type::duration offset) {
+    return std::filesystem::file_time_type(
+        std::chrono::duration_cast<std::filesystem::file_time_type::duration>(std::chrono::seconds(seconds) +
+                                                                             std::chrono::nanoseconds(nanoseconds)) +
+        offset);
+}
+
+/**
+ * @brief One statx (fstatat on older headers) for the requested fields.
+ * Modification times need fileClockOffset to have succeeded.
+ */
+inline bool statAt(int directoryFd, const char* name, unsigned fields, bool follow, EntryStatus& out,
+                   mode_t* mode = nullptr) {
+    std::filesystem::file_time_type::duration offset{};
+    if ((fields & kStatTimes) && !fileClockOffset(offset)) return false;
+#ifdef STATX_SIZE
+    unsigned mask = STATX_TYPE;
+    if (fields & kStatSize) mask |= STATX_SIZE;
+    if (fields & kStatModified) mask |= STATX_MTIME;
+    if (fields & kStatAccessed) mask |= STATX_ATIME;
+    if (fields & kStatChanged) mask |= STATX_CTIME;
+    if (fields & kStatOwner) mask |= STATX_UID;
+    if (fields & kStatInode) mask |= STATX_INO;
+    struct statx status;
+    if (::statx(directoryFd, name, follow ? 0 : AT_SYMLINK_NOFOLLOW, mask, &status) != 0) return false;
+    if (mode) *mode = status.stx_mode;
+    if (fields & kStatSize) out.size = status.stx_size;
+    if (fields & kStatModified) out.modified = toFileTime(status.stx_mtime.tv_sec, status.stx_mtime.tv_nsec, offset);
+    if (fields & kStatAccessed) out.accessed = toFileTime(status.stx_atime.tv_sec, status.stx_atime.tv_nsec, offset);
+    if (fields & kStatChanged) out.changed = toFileTime(status.stx_ctime.tv_sec, status.stx_ctime.tv_nsec, offset);
+    if (fields & kStatOwner) out.owner = status.stx_uid;
+    if (fields & kStatInode) out.inode = status.stx_ino;
+#else
+    struct stat status;
+    if (::fstatat(directoryFd, name, &status, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return false;
+    if (mode) *mode = status.st_mode;
+    if (fields & kStatSize) out.size = (uintmax_t)status.st_size;
+    if (fields & kStatModified) out.modified = toFileTime(status.st_mtim.tv_sec, status.st_mtim.tv_nsec, offset);
+    if (fields & kStatAccessed) out.accessed = toFileTime(status.st_atim.tv_sec, status.st_atim.tv_nsec, offset);
+    if (fields & kStatChanged) out.changed = toFileTime(status.st_ctim.tv_sec, status.st_ctim.tv_nsec, offset);
+    if (fields & kStatOwner) out.owner = status.st_uid;
+    if (fields & kStatInode) out.inode = status.st_ino;
+#endif
+    return true;
+}
+
+}  // namespace detail
+
+/**
+ * @brief One entry of the directory being read. Only valid until the reader
+ * moves on.
+ */
+class WalkEntry {
+public:
+    enum class Type { File, Directory, Symlink, Other };
+
+    std::string_view name() const {
+        return entryName;
+    }
+
+    /**
+     * @brief Builds the full path; the only allocation an entry costs, so
+     * ask for it only when it is needed
+     */
+    std::filesystem::path path() const {
+        return *directory / std::filesystem::path(entryName.begin(), entryName.end());
+    }
+
+    /**
+     * @brief Appends the full path to `out`, which allocates nothing once
+     * `out` has grown to fit
+     */
+    void appendPath(std::string& out) const {
+        const std::string& parent = directory->native();
+        out += parent;
+        if (!parent.empty() && parent.back() != '/') out += '/';
+        out += entryName;
+    }
+
+    /**
+     * @brief The entry's own type (a symlink is a Symlink), from d_type when
+     * the filesystem reports it
+     */
+    Type type() const {
+        if (entryType == DT_UNKNOWN) {
+            EntryStatus ignored;
+            mode_t mode = 0;
+            if (detail::statAt(directoryFd, entryName.data(), 0, false, ignored, &mode)) {
+                entryType = S_ISREG(mode) ? DT_REG : S_ISDIR(mode) ? DT_DIR : S_ISLNK(mode) ? DT_LNK : DT_FIFO;
+            } else {
+                entryType = DT_FIFO;
+            }
+        }
+        switch (entryType) {
+            case DT_REG: return Type::File;
+            case DT_DIR: return Type::Directory;
+            case DT_LNK: return Type::Symlink;
+            default: return Type::Other;
+        }
+    }
+
+    /**
+     * @brief True for regular files, and for symlinks to one (as
+     * std::filesystem::is_regular_file); costs no syscall for plain files
+     */
+    bool isRegularFile() const {
+        Type own = type();
+        if (own != Type::Symlink) return own == Type::File;
+        EntryStatus ignored;
+        mode_t mode = 0;
+        return detail::statAt(directoryFd, entryName.data(), 0, true, ignored, &mode) && S_ISREG(mode);
+    }
+
+    /**
+     * @brief Reads the requested StatField values with one statx, following
+     * symlinks
+     */
+    bool status(unsigned fields, EntryStatus& out) const {
+        std::filesystem::file_time_type::duration offset{};
+        if ((fields & kStatTimes) && !detail::fileClockOffset(offset)) {
+            return detail::statPortable(path(), fields, out);
+        }
+        return detail::statAt(directoryFd, entryName.data(), fields, true, out);
+    }
+
+    SavedEntry save() const {
+        return SavedEntry{std::string(entryName), entryType};
+    }
+
+private:
+    friend class DirectoryReader;
+
+    const std::filesystem::path* directory = nullptr;
+    int directoryFd = -1;
+    std::string_view entryName;  // NUL-terminated, inside the reader's buffer
+    mutable unsigned char entryType = DT_UNKNOWN;
+};
+
+/**
+ * @brief Reads one directory at a time with getdents64. A walking thread
+ * keeps one reader, so the buffer is allocated once per thread.
+ */
+class DirectoryReader {
+public:
+    DirectoryReader() : buffer(new char[kDirectoryReadBuffer]) {}
+
+    ~DirectoryReader() {
+        close();
+    }
+
+    DirectoryReader(const DirectoryReader&) = delete;
+    DirectoryReader& operator=(const DirectoryReader&) = delete;
+
+    /**
+     * @brief Starts reading `directory`; false if it cannot be opened (e.g.
+     * permission denied), which walks treat as an empty directory. Only the
+     * root of a walk may be a symlink to a directory; below it, a directory
+     * that was swapped for a symlink after it was listed is not followed.
+     */
+    bool open(const std::filesystem::path& directory, bool root = false) {
+        close();
+        fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | (root ? 0 : O_NOFOLLOW));
+        current = &directory;
+        used = position = 0;
+        exhausted = false;
+        return fd >= 0;
+    }
+
+    /**
+     * @brief Moves to the next entry other than "." and "..". False at the
+     * end of the directory or on a read error.
+     */
+    bool next(WalkEntry& entry) {
+        while (true) {
+            if (position >= used) {
+                if (fd < 0 || exhausted) return false;
+                long count = ::syscall(SYS_getdents64, fd, buffer.get(), kDirectoryReadBuffer);
+                if (count <= 0) {
+                    exhausted = true;  // the directory stays open for restore()
+                    return false;
+                }
+                used = (size_t)count;
+                position = 0;
+            }
+            // struct linux_dirent64: d_ino, d_off, d_reclen, d_type, d_name
+            const char* record = buffer.get() + position;
+            unsigned short length;
+            memcpy(&length, record + 16, sizeof(length));
+            position += length;
+            const char* name = record + 19;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+            entry.directory = current;
+            entry.directoryFd = fd;
+            entry.entryName = std::string_view(name);
+            entry.entryType = (unsigned char)record[18];
+            return true;
+        }
+    }
+
+    /**
+     * @brief Points `entry` at a saved entry of the directory being read
+     */
+    void restore(const SavedEntry& saved, WalkEntry& entry) const {
+        entry.directory = current;
+        entry.directoryFd = fd;
+        entry.entryName = saved.name;
+        entry.entryType = saved.type;
+    }
+
+private:
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    std::unique_ptr<char[]> buffer;
+    int fd = -1;
+    const std::filesystem::path* current = nullptr;
+    size_t used = 0;
+    size_t position = 0;
+    bool exhausted = false;
+};
+
+#else
+
+/**
+ * @brief An entry kept past the reader's next read, e.g. to sort a directory
+ */
+struct SavedEntry {
+    std::string name;
+    std::filesystem::directory_entry entry;
+};
+
+/**
+ * @brief One entry of the directory being read. Only valid until the reader
+ * moves on.
+ */
+class WalkEntry {
+public:
+    enum class Type { File, Directory, Symlink, Other };
+
+    std::string_view name() const {
+        return entryName;
+    }
+
+    std::filesystem::path path() const {
+        return entry->path();
+    }
+
+    void appendPath(std::string& out) const {
+        out += entry->path().string();
+    }
+
+    Type type() const {
+        std::error_code ec;
+        if (entry->is_symlink(ec)) return Type::Symlink;
+        if (entry->is_directory(ec)) return Type::Directory;
+        if (entry->is_regular_file(ec)) return Type::File;
+        return Type::Other;
+    }
+
+    bool isRegularFile() const {
+        std::error_code ec;
+        return entry->is_regular_file(ec);
+    }
+
+    /**
+     * @brief Reads the requested StatField values; the directory read has
+     * usually cached them already
+     */
+    bool status(unsigned fields, EntryStatus& out) const {
+        std::error_code ec;
+        if (fields & kStatSize) {
+            out.size = entry->file_size(ec);
+            if (ec) return false;
+        }
+        if (fields & kStatModified) {
+            out.modified = entry->last_write_time(ec);
+            if (ec) return false;
+        }
+        unsigned uncached = fields & (kStatAccessed | kStatChanged | kStatOwner | kStatInode);
+        return !uncached || detail::statPortable(entry->path(), uncached, out);
+    }
+
+    SavedEntry save() const {
+        return SavedEntry{entryName, *entry};
+    }
+
+private:
+    friend class DirectoryReader;
+
+    const std::filesystem::directory_entry* entry = nullptr;
+    std::string entryName;
+};
+
+/**
+ * @brief Reads one directory at a time with std::filesystem
+ */
+class DirectoryReader {
+public:
+    bool open(const std::filesystem::path& directory, bool root = false) {
+        (void)root;  // directory_iterator follows a symlinked root and never descends through others
+        std::error_code ec;
+        it = std::filesystem::directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied,
+                                                 ec);
+        if (ec) it = std::filesystem::directory_iterator();
+        started = false;
+        return !ec;
+    }
+
+    bool next(WalkEntry& entry) {
+        std::error_code ec;
+        if (started && it != std::filesystem::directory_iterator()) it.increment(ec);
+        started = true;
+        if (ec || it == std::filesystem::directory_iterator()) {
+            it = std::filesystem::directory_iterator();
+            return false;
+        }
+        entry.entry = &*it;
+        entry.entryName = it->path().filename().string();
+        return true;
+    }
+
+    void restore(const SavedEntry& saved, WalkEntry& entry) const {
+        entry.entry = &saved.entry;
+        entry.entryName = saved.name;
+    }
+
+private:
+    std::filesystem::directory_iterator it;
+    bool started = false;
+};
+
+#endif
+
+/**
+ * @brief The requested StatField values of a path, the same way a walk reads
+ * them, so values taken during a walk can be compared with it exactly
+ */
+inline bool statPath(const std::filesystem::path& path, unsigned fields, EntryStatus& out) {
+#ifdef __linux__
+    std::filesystem::file_time_type::duration offset{};
+    if (!(fields & kStatTimes) || detail::fileClockOffset(offset)) {
+        return detail::statAt(AT_FDCWD, path.c_str(), fields, true, out);
+    }
+#endif
+    return detail::statPortable(path, fields, out);
+}
+
+inline std::filesystem::file_time_type fileTimeFromTimeT(time_t seconds) {
+#ifdef __linux__
+    std::filesystem::file_time_type::duration offset{};
+    if (detail::fileClockOffset(offset)) return detail::toFileTime(seconds, 0, offset);
+#endif
+    // Through the system clock; off by at most the time between the two reads
+    auto sinceNow = std::chrono::system_clock::from_time_t(seconds) - std::chrono::system_clock::now();
+    return std::filesystem::file_time_type::clock::now() +
+           std::chrono::duration_cast<std::filesystem::file_time_type::duration>(sinceNow);
+}
+
+#endif // DECLUTTER_DIRECTORY_READER_HPP
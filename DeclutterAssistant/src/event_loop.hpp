@@ -0,0 +1,284 @@
+#ifndef DECLUTTER_EVENT_LOOP_HPP
+#define DECLUTTER_EVENT_LOOP_HPP
+
+#include "platform.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__) && !defined(DECLUTTER_USE_POLL)
+#define DECLUTTER_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+// ============================================================================
+// Event Loop (epoll reactor, poll fallback)
+// ============================================================================
+
+/**
+ * @brief Receives readiness notifications for one socket.
+ *
+ * On Linux sockets are registered edge-triggered, so a watcher must keep
+ * reading/writing until the call would block before it returns.
+ */
+class IoWatcher {
+public:
+    virtual ~IoWatcher() = default;
+    virtual void onEvents(uint32_t events) = 0;
+};
+
+/**
+ * @brief Single-threaded reactor. Everything except post() and stop() must
+ * be called from the thread running run().
+ *
+ * Linux uses edge-triggered epoll with an eventfd for cross-thread wakeups.
+ * Other platforms (and builds with DECLUTTER_USE_POLL) fall back to
+ * level-triggered poll()/WSAPoll with a loopback UDP socket for wakeups.
+ */
+class EventLoop {
+public:
+    enum Event : uint32_t {
+        Readable = 1,
+        Writable = 2,
+        Closed = 4
+    };
+
+    EventLoop() {
+#ifdef DECLUTTER_EPOLL
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+#else
+        wakeSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        bind(wakeSocket, (sockaddr*)&addr, sizeof(addr));
+        getsockname(wakeSocket, (sockaddr*)&addr, &len);
+        connect(wakeSocket, (sockaddr*)&addr, sizeof(addr));
+        setNonBlocking(wakeSocket);
+#endif
+    }
+
+    ~EventLoop() {
+#ifdef DECLUTTER_EPOLL
+        ::close(wakeFd);
+        ::close(epollFd);
+#else
+        closesocket(wakeSocket);
+#endif
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool watch(SOCKET fd, std::shared_ptr<IoWatcher> watcher) {
+#ifdef DECLUTTER_EPOLL
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+#endif
+        watchers[fd] = Watch{std::move(watcher), true, false};
+        return true;
+    }
+
+    void unwatch(SOCKET fd) {
+#ifdef DECLUTTER_EPOLL
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+        watchers.erase(fd);
+    }
+
+    /**
+     * @brief Pauses or resumes Readable notifications (flow control).
+     * With edge-triggered epoll the watcher simply stops reading and reads
+     * again when it resumes, so this only matters for the poll backend.
+     */
+    void setReadInterest(SOCKET fd, bool enabled) {
+        auto it = watchers.find(fd);
+        if (it != watchers.end()) it->second.wantRead = enabled;
+    }
+
+    /**
+     * @brief Asks for Writable notifications while output is pending.
+     * Edge-triggered epoll always reports writability, so this only
+     * matters for the poll backend.
+     */
+    void setWriteInterest(SOCKET fd, bool enabled) {
+        auto it = watchers.find(fd);
+        if (it != watchers.end()) it->second.wantWrite = enabled;
+    }
+
+    /**
+     * @brief Runs a task on the loop thread. Safe to call from any thread.
+     */
+    void post(std::function<void()> task) {
+        bool needWake = false;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pending.push_back(std::move(task));
+            if (!wakePending) {
+                wakePending = true;
+                needWake = true;
+            }
+        }
+        if (needWake) wake();
+    }
+
+    /**
+     * @brief Calls the ticker on the loop thread roughly every intervalMs.
+     * Used for housekeeping such as idle connection timeouts.
+     */
+    void setTicker(int intervalMs, std::function<void()> tick) {
+        tickInterval = std::chrono::milliseconds(intervalMs);
+        ticker = std::move(tick);
+        nextTick = std::chrono::steady_clock::now() + tickInterval;
+    }
+
+    void run() {
+        running = true;
+        while (running) {
+            waitAndDispatch(timeoutUntilTick());
+            runPending();
+            if (ticker && std::chrono::steady_clock::now() >= nextTick) {
+                ticker();
+                nextTick = std::chrono::steady_clock::now() + tickInterval;
+            }
+        }
+    }
+
+    void stop() {
+        running = false;
+        wake();
+    }
+
+private:
+    struct Watch {
+        std::shared_ptr<IoWatcher> watcher;
+        bool wantRead;
+        bool wantWrite;
+    };
+
+    int timeoutUntilTick() const {
+        if (!ticker) return -1;
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            nextTick - std::chrono::steady_clock::now()).count();
+        return remaining > 0 ? (int)remaining : 0;
+    }
+
+    void dispatch(SOCKET fd, uint32_t events) {
+        auto it = watchers.find(fd);
+        if (it == watchers.end()) return;
+        // Hold a reference: the watcher may unwatch itself from onEvents
+        std::shared_ptr<IoWatcher> watcher = it->second.watcher;
+        watcher->onEvents(events);
+    }
+
+#ifdef DECLUTTER_EPOLL
+    void waitAndDispatch(int timeoutMs) {
+        epoll_event events[256];
+        int count = epoll_wait(epollFd, events, 256, timeoutMs);
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                uint64_t value;
+                while (::read(wakeFd, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            uint32_t flags = events[i].events;
+            uint32_t mapped = 0;
+            if (flags & (EPOLLIN | EPOLLRDHUP)) mapped |= Readable;
+            if (flags & EPOLLOUT) mapped |= Writable;
+            if (flags & (EPOLLERR | EPOLLHUP)) mapped |= Closed | Readable;
+            dispatch(fd, mapped);
+        }
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+#else
+    void waitAndDispatch(int timeoutMs) {
+        pollFds.clear();
+        PollFd wakeEntry{};
+        wakeEntry.fd = wakeSocket;
+        wakeEntry.events = POLLIN;
+        pollFds.push_back(wakeEntry);
+        for (const auto& item : watchers) {
+            PollFd entry{};
+            entry.fd = item.first;
+            entry.events = 0;
+            if (item.second.wantRead) entry.events |= POLLIN;
+            if (item.second.wantWrite) entry.events |= POLLOUT;
+            pollFds.push_back(entry);
+        }
+
+        int count = pollSockets(pollFds.data(), pollFds.size(), timeoutMs);
+        if (count <= 0) return;
+
+        if (pollFds[0].revents) {
+            char drain[64];
+            while (recv(wakeSocket, drain, sizeof(drain), 0) > 0) {}
+        }
+        for (size_t i = 1; i < pollFds.size(); i++) {
+            short flags = pollFds[i].revents;
+            if (!flags) continue;
+            uint32_t mapped = 0;
+            if (flags & POLLIN) mapped |= Readable;
+            if (flags & POLLOUT) mapped |= Writable;
+            if (flags & (POLLERR | POLLHUP | POLLNVAL)) mapped |= Closed | Readable;
+            dispatch(pollFds[i].fd, mapped);
+        }
+    }
+
+    void wake() {
+        char one = 1;
+        send(wakeSocket, &one, 1, 0);
+    }
+#endif
+
+    void runPending() {
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            tasks.swap(pending);
+            wakePending = false;
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+    }
+
+#ifdef DECLUTTER_EPOLL
+    int epollFd;
+    int wakeFd;
+#else
+    SOCKET wakeSocket;
+    std::vector<PollFd> pollFds;
+#endif
+    std::unordered_map<SOCKET, Watch> watchers;
+    std::mutex pendingMutex;
+    std::vector<std::function<void()>> pending;
+    bool wakePending = false;
+    std::atomic<bool> running{false};
+    std::function<void()> ticker;
+    std::chrono::milliseconds tickInterval{0};
+    std::chrono::steady_clock::time_point nextTick;
+};
+
+#endif // DECLUTTER_EVENT_LOOP_HPP
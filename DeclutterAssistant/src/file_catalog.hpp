@@ -0,0 +1,1231 @@
+#ifndef DECLUTTER_FILE_CATALOG_HPP
+#define DECLUTTER_FILE_CATALOG_HPP
+
+#include "cancellation.hpp"
+#include "directory_reader.hpp"
+#include "parallel_walker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Persistent File Catalog (incremental rescans)
+// ============================================================================
+//
+// For each configured root the catalog holds every directory and regular
+// file below it, with what scans look at: name, size, modification time
+// and inode. It is saved to the catalog directory after every refresh that
+// changed it and memory-mapped back when the server starts, so a restarted
+// server does not have to walk its roots from scratch.
+//
+// A refresh stats each directory in scope and reads only those whose inode,
+// mtime or ctime differ from the catalog's; the others keep their listing.
+// A change deep in a tree does not touch its ancestors' times, so the
+// subdirectories of an unchanged directory are still checked, but that is
+// one stat per directory instead of a read and a stat per file.
+//
+// Writing to a file does not touch its directory either, so until the
+// directory changes the catalog keeps the size and time the file had when
+// it was last read. Cleanups look at every file again before deleting it:
+// a stale entry is kept, never deleted by mistake.
+//
+// Directories named as changed (by change notifications) whose
+// subdirectories stayed the same are patched instead. The next snapshot
+// shares the previous one's base, mapped or in memory, and adds an overlay
+// holding the new record and files of each patched directory. So an update
+// costs as much as the directories it reads, not the catalog. The overlay
+// is folded into a new base when the catalog is saved, or when it grows
+// large.
+
+// Catalog file format; a file of another version is ignored and rebuilt
+constexpr uint32_t kCatalogVersion = 1;
+
+// A directory modified this shortly before it was read may change again
+// within the same tick of a coarse filesystem clock, unnoticed; the next
+// refresh reads it again instead of trusting its times
+constexpr std::chrono::seconds kCatalogSettleTime(2);
+
+// A catalog kept up to date by change notifications is saved at most this
+// often; the one saved last is checked against the disk on the next start
+constexpr std::chrono::seconds kCatalogSaveInterval(60);
+
+// Requests waiting for another request's refresh of the same root check
+// their own cancellation this often
+constexpr std::chrono::milliseconds kCatalogPollInterval(50);
+
+// The status() fields a catalog entry can answer; filters asking for more
+// need a walk
+constexpr unsigned kCatalogStatFields = kStatSize | kStatModified | kStatInode;
+
+// No such directory (also the root's parent)
+constexpr uint32_t kCatalogNone = UINT32_MAX;
+
+// Written as-is, so a file from a machine of the other byte order is refused
+constexpr uint32_t kCatalogByteOrder = 0x01020304;
+
+// Set on a directory read within kCatalogSettleTime of its modification
+constexpr uint32_t kCatalogUnsettled = 1;
+
+// An overlay of patched directories is folded into a new base once it holds
+// this share of the base's file entries
+constexpr double kCatalogMaxOverlayShare = 0.5;
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    int64_t clockOffset;     // file times are only comparable on the same file clock
+    int64_t ticksPerSecond;
+    uint64_t directoryCount;
+    uint64_t fileCount;
+    uint64_t nameBytes;
+};
+
+/**
+ * @brief One directory. Directories are kept in pre-order with siblings
+ * sorted by name, so a directory's subtree is the range up to subtreeEnd
+ * and its first subdirectory, if any, comes right after it.
+ */
+struct CatalogDirectory {
+    uint64_t inode;
+    int64_t modified;  // file_time_type ticks
+    int64_t changed;   // 0 where the platform has no inode change time
+    uint32_t nameOffset;  // the root's name is its full path
+    uint32_t nameLength;
+    uint32_t parent;
+    uint32_t subtreeEnd;
+    uint32_t firstFile;
+    uint32_t fileCount;
+    uint32_t flags;
+    uint32_t unused;
+};
+
+/**
+ * @brief One regular file (or symlink to one); a directory's files are
+ * consecutive and sorted by name
+ */
+struct CatalogFile {
+    uint64_t size;
+    int64_t modified;  // file_time_type ticks
+    uint64_t inode;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+static_assert(sizeof(CatalogHeader) % 8 == 0 && sizeof(CatalogDirectory) % 8 == 0 && sizeof(CatalogFile) % 8 == 0,
+              "catalog records must keep the ones after them aligned");
+
+namespace detail {
+
+inline int64_t catalogTicks(std::filesystem::file_time_type time) {
+    return (int64_t)time.time_since_epoch().count();
+}
+
+inline std::filesystem::file_time_type catalogTime(int64_t ticks) {
+    return std::filesystem::file_time_type(std::filesystem::file_time_type::duration(ticks));
+}
+
+inline int64_t catalogClockOffset() {
+#ifdef __linux__
+    std::filesystem::file_time_type::duration offset{};
+    if (fileClockOffset(offset)) return (int64_t)offset.count();
+#endif
+    return 0;
+}
+
+}  // namespace detail
+
+/**
+ * @brief A directory's files, and the names they point into
+ */
+struct CatalogFileRange {
+    const CatalogFile* first;
+    uint32_t count;
+    const char* names;
+
+    const CatalogFile* begin() const {
+        return first;
+    }
+
+    const CatalogFile* end() const {
+        return first + count;
+    }
+
+    std::string_view name(const CatalogFile& file) const {
+        return std::string_view(names + file.nameOffset, file.nameLength);
+    }
+};
+
+/**
+ * @brief A directory read again since its snapshot's base was built. Its
+ * record keeps the base's name and tree fields; its files index `files`
+ * and name into `names`.
+ */
+struct CatalogPatch {
+    CatalogDirectory record;
+    std::vector<CatalogFile> files;
+    std::string names;
+};
+
+/**
+ * @brief A file of the catalog as a walk entry, so filters and listings can
+ * look at it the way they look at a WalkEntry
+ */
+class CatalogEntry {
+public:
+    CatalogEntry(const std::filesystem::path& directory, std::string_view name, const CatalogFile& file)
+        : directory(directory), entryName(name), file(file) {}
+
+    std::string_view name() const {
+        return entryName;
+    }
+
+    std::filesystem::path path() const {
+        return directory / std::filesystem::path(entryName.begin(), entryName.end());
+    }
+
+    void appendPath(std::string& out) const {
+        const std::string parent = directory.string();
+        out += parent;
+        char separator = (char)std::filesystem::path::preferred_separator;
+        if (!parent.empty() && parent.back() != separator && parent.back() != '/') out += separator;
+        out += entryName;
+    }
+
+    bool isRegularFile() const {
+        return true;  // nothing else is cataloged
+    }
+
+    /**
+     * @brief The cataloged fields; false if others are asked for
+     */
+    bool status(unsigned fields, EntryStatus& out) const {
+        if (fields & ~kCatalogStatFields) return false;
+        out.size = file.size;
+        out.modified = detail::catalogTime(file.modified);
+        out.inode = file.inode;
+        return true;
+    }
+
+private:
+    const std::filesystem::path& directory;
+    std::string_view entryName;
+    const CatalogFile& file;
+};
+
+/**
+ * @brief One immutable state of a root's catalog: a base, either
+ * memory-mapped from its file or held in memory, and an overlay of patched
+ * directories. Shared by every walk reading it, so a refresh replaces it
+ * instead of changing it.
+ */
+class CatalogSnapshot {
+public:
+    ~CatalogSnapshot() {
+#ifndef _WIN32
+        if (mapping) ::munmap(mapping, mappingSize);
+#endif
+    }
+
+    CatalogSnapshot(const CatalogSnapshot&) = delete;
+    CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+
+    /**
+     * @brief Takes a serialized catalog; null if it is not valid. One built
+     * from a checked snapshot skips the check (`verified`).
+     */
+    static std::shared_ptr<const CatalogSnapshot> fromImage(std::string image, bool verified = false) {
+        std::shared_ptr<CatalogSnapshot> snapshot(new CatalogSnapshot());
+        snapshot->image = std::move(image);
+        if (!snapshot->attach(snapshot->image.data(), snapshot->image.size(), verified)) return nullptr;
+        return snapshot;
+    }
+
+    /**
+     * @brief The previous snapshot with these directories replaced. Shares
+     * its base; only the overlay is copied, not the catalog.
+     */
+    static std::shared_ptr<const CatalogSnapshot> withPatches(
+        const std::shared_ptr<const CatalogSnapshot>& previous,
+        std::vector<std::pair<uint32_t, std::shared_ptr<const CatalogPatch>>> patches) {
+        std::shared_ptr<CatalogSnapshot> snapshot(new CatalogSnapshot());
+        snapshot->base = previous->base ? previous->base : previous;
+        snapshot->data = previous->data;
+        snapshot->size = previous->size;
+        snapshot->header = previous->header;
+        snapshot->directories = previous->directories;
+        snapshot->files = previous->files;
+        snapshot->names = previous->names;
+        snapshot->overlay = previous->overlay;
+        for (auto& patch : patches) snapshot->overlay[patch.first] = std::move(patch.second);
+        for (const auto& entry : snapshot->overlay) snapshot->overlayFiles += entry.second->files.size();
+        return snapshot;
+    }
+
+    /**
+     * @brief Serializes catalog records; `names` holds every name they
+     * point into
+     */
+    static std::string serialize(const std::vector<CatalogDirectory>& directories,
+                                 const std::vector<CatalogFile>& files, const std::string& names) {
+        CatalogHeader header{};
+        memcpy(header.magic, "DCATALOG", 8);
+        header.version = kCatalogVersion;
+        header.byteOrder = kCatalogByteOrder;
+        header.clockOffset = detail::catalogClockOffset();
+        header.ticksPerSecond = (int64_t)std::filesystem::file_time_type::period::den;
+        header.directoryCount = directories.size();
+        header.fileCount = files.size();
+        header.nameBytes = names.size();
+
+        std::string out;
+        out.reserve(sizeof(header) + directories.size() * sizeof(CatalogDirectory) +
+                    files.size() * sizeof(CatalogFile) + names.size());
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.append(reinterpret_cast<const char*>(directories.data()), directories.size() * sizeof(CatalogDirectory));
+        out.append(reinterpret_cast<const char*>(files.data()), files.size() * sizeof(CatalogFile));
+        out.append(names);
+        return out;
+    }
+
+    /**
+     * @brief The same catalog as a base without an overlay, packed: the
+     * entries the overlay replaced are left out. Null if that is too large.
+     */
+    std::shared_ptr<const CatalogSnapshot> folded() const {
+        uint32_t count = directoryCount();
+        std::vector<CatalogDirectory> foldedDirectories;
+        std::vector<CatalogFile> foldedFiles;
+        std::string foldedNames;
+        foldedDirectories.reserve(count);
+        foldedFiles.reserve(header->fileCount - overlayReplaced() + overlayFiles);
+        foldedNames.reserve(header->nameBytes);
+        for (uint32_t index = 0; index < count; index++) {
+            CatalogDirectory record = directory(index);
+            CatalogFileRange range = filesOf(index);
+            if (foldedFiles.size() + range.count >= kCatalogNone) return nullptr;
+            std::string_view directoryName = name(record);
+            if (foldedNames.size() + directoryName.size() > UINT32_MAX) return nullptr;
+            record.nameOffset = (uint32_t)foldedNames.size();
+            foldedNames.append(directoryName.data(), directoryName.size());
+            record.firstFile = (uint32_t)foldedFiles.size();
+            for (const CatalogFile& file : range) {
+                CatalogFile copy = file;
+                std::string_view fileName = range.name(file);
+                if (foldedNames.size() + fileName.size() > UINT32_MAX) return nullptr;
+                copy.nameOffset = (uint32_t)foldedNames.size();
+                foldedNames.append(fileName.data(), fileName.size());
+                foldedFiles.push_back(copy);
+            }
+            foldedDirectories.push_back(record);
+        }
+        return fromImage(serialize(foldedDirectories, foldedFiles, foldedNames), true);
+    }
+
+    /**
+     * @brief Maps a saved catalog; null if it is missing, was written by
+     * another version or machine, or is damaged
+     */
+    static std::shared_ptr<const CatalogSnapshot> load(const std::filesystem::path& file) {
+        std::shared_ptr<CatalogSnapshot> snapshot(new CatalogSnapshot());
+#ifndef _WIN32
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return nullptr;
+        struct stat status;
+        if (::fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(CatalogHeader)) {
+            ::close(fd);
+            return nullptr;
+        }
+        void* mapped = ::mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return nullptr;
+        snapshot->mapping = mapped;
+        snapshot->mappingSize = (size_t)status.st_size;
+        if (!snapshot->attach((const char*)mapped, snapshot->mappingSize)) return nullptr;
+#else
+        std::ifstream in(file, std::ios::binary);
+        if (!in) return nullptr;
+        snapshot->image.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (!snapshot->attach(snapshot->image.data(), snapshot->image.size())) return nullptr;
+#endif
+        return snapshot;
+    }
+
+    /**
+     * @brief Writes the catalog next to `file` and renames it into place, so
+     * a crash never leaves half a catalog behind. An overlay is folded in.
+     */
+    bool save(const std::filesystem::path& file) const {
+        if (!overlay.empty()) {
+            auto flat = folded();
+            return flat && flat->save(file);
+        }
+        std::filesystem::path temporary = file;
+        temporary += ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out.write(data, (std::streamsize)size) || !out.flush()) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(temporary, file, ec);
+        if (ec) std::filesystem::remove(temporary, ec);
+        return !ec;
+    }
+
+    uint32_t directoryCount() const {
+        return (uint32_t)header->directoryCount;
+    }
+
+    /**
+     * @brief File entries of the base, the ones an overlay replaced included
+     */
+    uint64_t fileCount() const {
+        return header->fileCount;
+    }
+
+    /**
+     * @brief File entries held by the overlay
+     */
+    uint64_t overlaidFiles() const {
+        return overlayFiles;
+    }
+
+    bool overlaid() const {
+        return !overlay.empty();
+    }
+
+    const CatalogDirectory& directory(uint32_t index) const {
+        if (!overlay.empty()) {
+            auto it = overlay.find(index);
+            if (it != overlay.end()) return it->second->record;
+        }
+        return directories[index];
+    }
+
+    /**
+     * @brief A directory's files, from the overlay if it was patched
+     */
+    CatalogFileRange filesOf(uint32_t index) const {
+        if (!overlay.empty()) {
+            auto it = overlay.find(index);
+            if (it != overlay.end()) {
+                const CatalogPatch& patch = *it->second;
+                return CatalogFileRange{patch.files.data(), (uint32_t)patch.files.size(), patch.names.data()};
+            }
+        }
+        const CatalogDirectory& record = directories[index];
+        return CatalogFileRange{files + record.firstFile, record.fileCount, names};
+    }
+
+    /**
+     * @brief How many subdirectories a directory has, skipping over their
+     * subtrees
+     */
+    size_t childCount(uint32_t index) const {
+        size_t count = 0;
+        for (uint32_t child = index + 1; child < directories[index].subtreeEnd; child = directories[child].subtreeEnd) {
+            count++;
+        }
+        return count;
+    }
+
+    // Patched records keep the base's name, so this holds for them too
+    std::string_view name(const CatalogDirectory& record) const {
+        return std::string_view(names + record.nameOffset, record.nameLength);
+    }
+
+    /**
+     * @brief The subdirectory of `parent` with this name, or kCatalogNone
+     */
+    uint32_t child(uint32_t parent, std::string_view childName) const {
+        for (uint32_t index = parent + 1; index < directories[parent].subtreeEnd;
+             index = directories[index].subtreeEnd) {
+            if (name(directories[index]) == childName) return index;
+        }
+        return kCatalogNone;
+    }
+
+    /**
+     * @brief The directory with this (normalized) path, or kCatalogNone
+     */
+    uint32_t find(std::string_view path) const {
+        std::string_view root = name(directories[0]);
+        if (path == root) return 0;
+        if (path.size() <= root.size() || path.compare(0, root.size(), root) != 0) return kCatalogNone;
+        size_t position = root.size();
+        if (!isSeparator(root.back())) {
+            if (!isSeparator(path[position])) return kCatalogNone;
+            position++;
+        }
+
+        uint32_t index = 0;
+        while (position < path.size() && index != kCatalogNone) {
+            size_t end = position;
+            while (end < path.size() && !isSeparator(path[end])) end++;
+            if (end > position) index = child(index, path.substr(position, end - position));
+            position = end + 1;
+        }
+        return index;
+    }
+
+private:
+    CatalogSnapshot() = default;
+
+    static bool isSeparator(char c) {
+        return c == '/' || c == (char)std::filesystem::path::preferred_separator;
+    }
+
+    /**
+     * @brief Base file entries the overlay stands in for
+     */
+    uint64_t overlayReplaced() const {
+        uint64_t replaced = 0;
+        for (const auto& entry : overlay) replaced += directories[entry.first].fileCount;
+        return replaced;
+    }
+
+    /**
+     * @brief Checks a serialized catalog from end to end before anything
+     * trusts its indexes; past the header, unless it is `verified` already
+     */
+    bool attach(const char* bytes, size_t length, bool verified = false) {
+        if (length < sizeof(CatalogHeader)) return false;
+        header = reinterpret_cast<const CatalogHeader*>(bytes);
+        if (memcmp(header->magic, "DCATALOG", 8) != 0 || header->version != kCatalogVersion ||
+            header->byteOrder != kCatalogByteOrder || header->clockOffset != detail::catalogClockOffset() ||
+            header->ticksPerSecond != (int64_t)std::filesystem::file_time_type::period::den) {
+            return false;
+        }
+        if (header->directoryCount == 0 || header->directoryCount >= kCatalogNone ||
+            header->fileCount >= kCatalogNone || header->nameBytes > UINT32_MAX) {
+            return false;
+        }
+        uint64_t expected = sizeof(CatalogHeader) + header->directoryCount * sizeof(CatalogDirectory) +
+                            header->fileCount * sizeof(CatalogFile) + header->nameBytes;
+        if (expected != length) return false;
+
+        directories = reinterpret_cast<const CatalogDirectory*>(bytes + sizeof(CatalogHeader));
+        files = reinterpret_cast<const CatalogFile*>(directories + header->directoryCount);
+        names = reinterpret_cast<const char*>(files + header->fileCount);
+        data = bytes;
+        size = length;
+        if (verified) return true;
+
+        uint32_t count = (uint32_t)header->directoryCount;
+        for (uint32_t index = 0; index < count; index++) {
+            const CatalogDirectory& record = directories[index];
+            // The parent is checked before it is looked at
+            if ((index == 0) != (record.parent == kCatalogNone)) return false;
+            if (index > 0 && record.parent >= index) return false;
+            uint32_t limit = index == 0 ? count : directories[record.parent].subtreeEnd;
+            if (record.subtreeEnd <= index || record.subtreeEnd > limit) return false;
+            if ((uint64_t)record.nameOffset + record.nameLength > header->nameBytes) return false;
+            if ((uint64_t)record.firstFile + record.fileCount > header->fileCount) return false;
+        }
+        for (uint64_t index = 0; index < header->fileCount; index++) {
+            if ((uint64_t)files[index].nameOffset + files[index].nameLength > header->nameBytes) return false;
+        }
+        return true;
+    }
+
+    std::string image;  // the bytes, when not mapped
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    const char* data = nullptr;
+    size_t size = 0;
+    const CatalogHeader* header = nullptr;
+    const CatalogDirectory* directories = nullptr;
+    const CatalogFile* files = nullptr;
+    const char* names = nullptr;
+
+    // Keeps the base's bytes alive; null for a base itself
+    std::shared_ptr<const CatalogSnapshot> base;
+    std::unordered_map<uint32_t, std::shared_ptr<const CatalogPatch>> overlay;  // by directory index
+    uint64_t overlayFiles = 0;
+};
+
+/**
+ * @brief What a refresh looks at. Directories in the subtrees are stat'ed
+ * and read again if they changed; the changed directories (e.g. named by
+ * change notifications) are read again regardless. The rest is copied from
+ * the previous snapshot unchecked.
+ */
+struct CatalogTargets {
+    std::vector<std::filesystem::path> subtrees;
+    std::unordered_set<std::string> changed;
+};
+
+/**
+ * @brief Called with each directory a refresh is about to look at
+ */
+using CatalogDirectoryHook = std::function<void(const std::filesystem::path& directory)>;
+
+/**
+ * @brief Builds the next snapshot of a root from the filesystem and the
+ * previous snapshot
+ */
+class CatalogRefresh {
+public:
+    CatalogRefresh(std::shared_ptr<const CatalogSnapshot> previous, CatalogTargets targets,
+                   CancellationToken* cancellation, CatalogDirectoryHook hook = nullptr)
+        : previous(std::move(previous)), targets(std::move(targets)), cancellation(cancellation),
+          hook(std::move(hook)), now(std::filesystem::file_time_type::clock::now()) {
+        directoryFields = kStatModified;
+        if (statFieldsSupported(kStatChanged | kStatInode)) directoryFields |= kStatChanged | kStatInode;
+        fileFields = kStatSize | kStatModified;
+        if (statFieldsSupported(kStatInode)) fileFields |= kStatInode;
+    }
+
+    // NotPatchable: patch() cannot express the change; run() can
+    enum class Result { Built, Stopped, TooLarge, NotPatchable };
+
+    Result run(const std::string& root) {
+        uint32_t previousRoot = previous ? 0 : kCatalogNone;
+        if (!add(root, root, kCatalogNone, previousRoot, isSubtree(root))) {
+            return tooLarge ? Result::TooLarge : Result::Stopped;
+        }
+        return Result::Built;
+    }
+
+    /**
+     * @brief Reads only the changed directories again, each into a patch
+     * for the previous snapshot's overlay. NotPatchable if a directory is
+     * new or gone, or gained, lost or renamed a subdirectory, which moves
+     * the directories after it.
+     */
+    Result patch() {
+        patching = true;
+        for (const std::string& changedPath : targets.changed) {
+            if (cancellation && cancellation->stopRequested()) return Result::Stopped;
+            uint32_t index = previous->find(changedPath);
+            if (index == kCatalogNone) return Result::NotPatchable;
+            std::filesystem::path path(changedPath);
+            if (hook) hook(path);
+            EntryStatus status;
+            checked++;
+            if (!statPath(path, directoryFields, status)) return Result::NotPatchable;
+
+            const CatalogDirectory& before = previous->directory(index);
+            CatalogDirectory record = before;
+            record.inode = status.inode;
+            record.modified = detail::catalogTicks(status.modified);
+            record.changed = (directoryFields & kStatChanged) ? detail::catalogTicks(status.changed) : 0;
+            record.flags &= ~kCatalogUnsettled;
+            if (now - status.modified < kCatalogSettleTime) record.flags |= kCatalogUnsettled;
+
+            std::vector<Subdirectory> subdirectories;
+            files.clear();
+            names.clear();
+            if (!readDirectory(path, subdirectories, index == 0)) {
+                return tooLarge ? Result::TooLarge : Result::Stopped;
+            }
+            size_t count = 0;
+            for (uint32_t child = index + 1; child < before.subtreeEnd; child = previous->directory(child).subtreeEnd) {
+                if (count >= subdirectories.size() ||
+                    previous->name(previous->directory(child)) != subdirectories[count].name) {
+                    return Result::NotPatchable;
+                }
+                count++;
+            }
+            if (count != subdirectories.size()) return Result::NotPatchable;
+            if (files.size() >= kCatalogNone) return Result::TooLarge;
+
+            std::shared_ptr<CatalogPatch> patched(new CatalogPatch());
+            record.firstFile = 0;
+            record.fileCount = (uint32_t)files.size();
+            patched->record = record;
+            patched->files = std::move(files);
+            patched->names = std::move(names);
+            patches.emplace_back(index, std::move(patched));
+        }
+        modified = !patches.empty();
+        return Result::Built;
+    }
+
+    /**
+     * @brief Whether the last Built result came from patch()
+     */
+    bool patched() const {
+        return patching;
+    }
+
+    /**
+     * @brief The directories a patch read, for CatalogSnapshot::withPatches
+     */
+    std::vector<std::pair<uint32_t, std::shared_ptr<const CatalogPatch>>> takePatches() {
+        return std::move(patches);
+    }
+
+    /**
+     * @brief Whether anything differs from the previous snapshot
+     */
+    bool changed() const {
+        return modified;
+    }
+
+    size_t directoriesChecked() const {
+        return checked;
+    }
+
+    size_t directoriesRead() const {
+        return read;
+    }
+
+    /**
+     * @brief The serialized catalog; valid after a Built run
+     */
+    std::string image() const {
+        return CatalogSnapshot::serialize(directories, files, names);
+    }
+
+private:
+    struct Subdirectory {
+        std::string name;
+        uint32_t previous;  // its index in the previous snapshot, or kCatalogNone
+    };
+
+    struct FoundFile {
+        std::string name;
+        EntryStatus status;
+    };
+
+    /**
+     * @brief Adds a directory and its subtree, reusing the previous listing
+     * where the directory is unchanged. False if stopped or too large.
+     */
+    bool add(const std::filesystem::path& path, std::string_view name, uint32_t parent, uint32_t known,
+             bool inScope) {
+        if (cancellation && cancellation->stopRequested()) return false;
+        if (directories.size() >= kCatalogNone - 1) return overflow();
+
+        // A directory the previous snapshot does not have is read in full
+        inScope = inScope || known == kCatalogNone;
+        bool forced = !targets.changed.empty() && targets.changed.count(path.string()) > 0;
+
+        CatalogDirectory record{};
+        bool reuse = false;
+        if (inScope || forced) {
+            if (hook) hook(path);
+            EntryStatus status;
+            checked++;
+            if (!statPath(path, directoryFields, status)) {
+                modified = true;
+                return true;  // gone since its parent was read
+            }
+            record.inode = status.inode;
+            record.modified = detail::catalogTicks(status.modified);
+            record.changed = (directoryFields & kStatChanged) ? detail::catalogTicks(status.changed) : 0;
+            if (known != kCatalogNone && !forced) {
+                const CatalogDirectory& before = previous->directory(known);
+                reuse = !(before.flags & kCatalogUnsettled) && before.inode == record.inode &&
+                        before.modified == record.modified && before.changed == record.changed;
+            }
+            if (!reuse && now - status.modified < kCatalogSettleTime) record.flags |= kCatalogUnsettled;
+        } else {
+            record = previous->directory(known);
+            reuse = true;
+        }
+
+        uint32_t index = (uint32_t)directories.size();
+        record.parent = parent;
+        record.firstFile = (uint32_t)files.size();
+        if (!addName(name, record.nameOffset, record.nameLength)) return false;
+        directories.push_back(record);
+
+        std::vector<Subdirectory> subdirectories;
+        if (reuse) {
+            const CatalogDirectory& before = previous->directory(known);
+            CatalogFileRange range = previous->filesOf(known);
+            for (CatalogFile file : range) {
+                if (!addName(range.name(file), file.nameOffset, file.nameLength)) return false;
+                files.push_back(file);
+            }
+            for (uint32_t child = known + 1; child < before.subtreeEnd; child = previous->directory(child).subtreeEnd) {
+                subdirectories.push_back(Subdirectory{std::string(previous->name(previous->directory(child))), child});
+            }
+        } else {
+            modified = true;
+            if (!readDirectory(path, subdirectories, parent == kCatalogNone)) return false;
+            if (known != kCatalogNone) matchPrevious(known, subdirectories);
+        }
+        if (files.size() >= kCatalogNone) return overflow();
+        directories[index].fileCount = (uint32_t)files.size() - directories[index].firstFile;
+
+        for (const Subdirectory& subdirectory : subdirectories) {
+            std::filesystem::path childPath = path / subdirectory.name;
+            bool childInScope = inScope || isSubtree(childPath);
+            if (!add(childPath, subdirectory.name, index, subdirectory.previous, childInScope)) return false;
+        }
+        directories[index].subtreeEnd = (uint32_t)directories.size();
+        return true;
+    }
+
+    /**
+     * @brief Lists a directory like a walk would: real subdirectories to
+     * descend into, and regular files (or symlinks to one) with their status
+     */
+    bool readDirectory(const std::filesystem::path& path, std::vector<Subdirectory>& subdirectories, bool root) {
+        read++;
+        std::vector<FoundFile> found;
+        // Unreadable directories (e.g. permission denied) are just empty
+        reader.open(path, root);
+        WalkEntry entry;
+        size_t entriesSinceCheck = 0;
+        while (reader.next(entry)) {
+            if (++entriesSinceCheck == kCancellationCheckInterval) {
+                entriesSinceCheck = 0;
+                if (cancellation && cancellation->stopRequested()) return false;
+            }
+            if (entry.type() == WalkEntry::Type::Directory) {
+                subdirectories.push_back(Subdirectory{std::string(entry.name()), kCatalogNone});
+                continue;
+            }
+            FoundFile file;
+            if (!entry.isRegularFile() || !entry.status(fileFields, file.status)) continue;
+            file.name = std::string(entry.name());
+            found.push_back(std::move(file));
+        }
+
+        std::sort(found.begin(), found.end(), [](const FoundFile& a, const FoundFile& b) { return a.name < b.name; });
+        for (const FoundFile& file : found) {
+            CatalogFile record{};
+            record.size = file.status.size;
+            record.modified = detail::catalogTicks(file.status.modified);
+            record.inode = file.status.inode;
+            if (!addName(file.name, record.nameOffset, record.nameLength)) return false;
+            files.push_back(record);
+        }
+        std::sort(subdirectories.begin(), subdirectories.end(),
+                  [](const Subdirectory& a, const Subdirectory& b) { return a.name < b.name; });
+        return true;
+    }
+
+    /**
+     * @brief Finds the subdirectories that were there before; both lists are
+     * sorted by name
+     */
+    void matchPrevious(uint32_t known, std::vector<Subdirectory>& subdirectories) const {
+        uint32_t end = previous->directory(known).subtreeEnd;
+        uint32_t child = known + 1;
+        for (Subdirectory& subdirectory : subdirectories) {
+            while (child < end && previous->name(previous->directory(child)) < subdirectory.name) {
+                child = previous->directory(child).subtreeEnd;
+            }
+            if (child < end && previous->name(previous->directory(child)) == subdirectory.name) {
+                subdirectory.previous = child;
+            }
+        }
+    }
+
+    bool addName(std::string_view name, uint32_t& offset, uint32_t& length) {
+        if (names.size() + name.size() > UINT32_MAX) return overflow();
+        offset = (uint32_t)names.size();
+        length = (uint32_t)name.size();
+        names.append(name.data(), name.size());
+        return true;
+    }
+
+    bool overflow() {
+        tooLarge = true;
+        return false;
+    }
+
+    bool isSubtree(const std::filesystem::path& path) const {
+        return std::find(targets.subtrees.begin(), targets.subtrees.end(), path) != targets.subtrees.end();
+    }
+
+    std::shared_ptr<const CatalogSnapshot> previous;
+    CatalogTargets targets;
+    CancellationToken* cancellation;
+    CatalogDirectoryHook hook;
+    std::filesystem::file_time_type now;
+    unsigned directoryFields;
+    unsigned fileFields;
+    DirectoryReader reader;
+
+    std::vector<CatalogDirectory> directories;
+    std::vector<CatalogFile> files;  // patch: the directory being read
+    std::string names;
+    bool modified = false;
+    bool patching = false;
+    std::vector<std::pair<uint32_t, std::shared_ptr<const CatalogPatch>>> patches;
+    bool tooLarge = false;
+    size_t checked = 0;
+    size_t read = 0;
+};
+
+/**
+ * @brief The catalogs of the configured roots. A walk of a directory below
+ * one of them refreshes that subtree of its catalog and then reads the
+ * catalog instead of the filesystem. A root whose changes are being
+ * followed (see CatalogWatcher) is live: walks read its catalog as it is.
+ */
+class FileCatalog {
+public:
+    enum class Walk { Unavailable, Completed, Stopped };
+
+    /**
+     * @brief Called with a root's index and each directory a refresh of it
+     * is about to look at, from whichever thread runs the refresh
+     */
+    using DirectoryHook = std::function<void(size_t root, const std::filesystem::path& directory)>;
+
+    /**
+     * @brief Catalogs these roots (normalized paths). With a directory, each
+     * catalog is saved there and the ones an earlier run saved are loaded.
+     */
+    void configure(const std::vector<std::string>& rootPaths, const std::filesystem::path& directory) {
+        std::error_code ec;
+        if (!directory.empty()) std::filesystem::create_directories(directory, ec);
+        for (const std::string& path : rootPaths) {
+            if (path.empty()) continue;
+            std::unique_ptr<Root> root(new Root());
+            root->index = roots.size();
+            root->path = path;
+            if (!directory.empty()) root->file = directory / catalogFileName(path);
+            if (!root->file.empty()) {
+                auto saved = CatalogSnapshot::load(root->file);
+                if (saved && saved->name(saved->directory(0)) == path) {
+                    std::cout << "Loaded the catalog of " << path << ": " << saved->directoryCount()
+                              << " directories, " << saved->fileCount() << " files" << std::endl;
+                    root->snapshot = std::move(saved);
+                }
+            }
+            roots.push_back(std::move(root));
+        }
+    }
+
+    size_t rootCount() const {
+        return roots.size();
+    }
+
+    const std::string& rootPath(size_t index) const {
+        return roots[index]->path;
+    }
+
+    /**
+     * @brief Set once, before the first walk
+     */
+    void setDirectoryHook(DirectoryHook directoryHook) {
+        hook = std::move(directoryHook);
+    }
+
+    /**
+     * @brief Marks a root's catalog as kept up to date by someone else, so
+     * walks stop refreshing it themselves
+     */
+    void setLive(size_t index, bool live) {
+        std::lock_guard<std::mutex> lock(roots[index]->mutex);
+        roots[index]->live = live;
+    }
+
+    /**
+     * @brief Refreshes the targets of a root's catalog; the whole root if it
+     * has no catalog yet. Changed directories alone are patched in where
+     * they can be. Waits for a refresh already running. The result is saved
+     * at most every kCatalogSaveInterval.
+     */
+    bool update(size_t index, CatalogTargets targets) {
+        Root& root = *roots[index];
+        std::lock_guard<std::timed_mutex> held(root.refreshing);
+        std::shared_ptr<const CatalogSnapshot> previous;
+        {
+            std::lock_guard<std::mutex> lock(root.mutex);
+            if (root.disabled) return false;
+            previous = root.snapshot;
+        }
+        if (!previous) targets.subtrees.assign(1, root.path);
+        bool stopped = false;
+        return rebuild(root, previous, std::move(targets), nullptr, false, stopped) != nullptr;
+    }
+
+    /**
+     * @brief Saves the catalogs whose latest state has not been saved yet
+     */
+    void flush() {
+        for (const auto& root : roots) {
+            std::lock_guard<std::timed_mutex> held(root->refreshing);
+            if (!root->unsaved) continue;
+            std::shared_ptr<const CatalogSnapshot> snapshot;
+            {
+                std::lock_guard<std::mutex> lock(root->mutex);
+                snapshot = root->snapshot;
+            }
+            if (snapshot && snapshot->save(root->file)) root->unsaved = false;
+        }
+    }
+
+    /**
+     * @brief Hands the files of one directory to `visit` as CatalogEntry
+     * objects, if a live catalog holds it. False if it has to be read from
+     * the disk instead.
+     */
+    template <typename Visit>
+    bool visitLiveDirectory(const std::string& directory, const Visit& visit) {
+        Root* root = rootFor(directory);
+        std::shared_ptr<const CatalogSnapshot> snapshot = root ? liveSnapshot(*root) : nullptr;
+        uint32_t index = snapshot ? snapshot->find(directory) : kCatalogNone;
+        if (index == kCatalogNone) return false;
+        std::filesystem::path path(directory);
+        CatalogFileRange range = snapshot->filesOf(index);
+        for (const CatalogFile& file : range) visit(CatalogEntry(path, range.name(file), file));
+        return true;
+    }
+
+    /**
+     * @brief Brings the catalog up to date below `directory` (normalized) and
+     * hands its directories to inspect and deliver like an ordered
+     * ParallelWalker would. Unavailable if no cataloged root contains the
+     * directory or it cannot be cataloged; the caller walks it itself then.
+     *
+     * `inspect` is called with CatalogEntry objects.
+     */
+    template <typename Record, typename Inspect, typename Deliver>
+    Walk walk(const std::string& directory, CancellationToken* cancellation, const Inspect& inspect,
+              const Deliver& deliver) {
+        Root* root = rootFor(directory);
+        if (!root) return Walk::Unavailable;
+        bool stopped = false;
+        std::shared_ptr<const CatalogSnapshot> snapshot = liveSnapshot(*root);
+        if (!snapshot) snapshot = refresh(*root, directory, cancellation, stopped);
+        if (!snapshot) return stopped ? Walk::Stopped : Walk::Unavailable;
+        uint32_t start = snapshot->find(directory);
+        if (start == kCatalogNone) return Walk::Unavailable;
+
+        // The directories from the start down to the current one
+        std::vector<std::pair<uint32_t, std::filesystem::path>> ancestors;
+        std::vector<Record> records;
+        size_t entriesSinceCheck = 0;
+        uint32_t end = snapshot->directory(start).subtreeEnd;
+        for (uint32_t index = start; index < end; index++) {
+            if (cancellation && cancellation->stopRequested()) return Walk::Stopped;
+            const CatalogDirectory& record = snapshot->directory(index);
+            while (!ancestors.empty() && ancestors.back().first != record.parent) ancestors.pop_back();
+            int depth = (int)ancestors.size();
+            std::filesystem::path path = ancestors.empty()
+                                             ? std::filesystem::path(directory)
+                                             : ancestors.back().second / std::string(snapshot->name(record));
+            ancestors.emplace_back(index, std::move(path));
+            const std::filesystem::path& current = ancestors.back().second;
+
+            size_t files = 0;
+            records.clear();
+            CatalogFileRange range = snapshot->filesOf(index);
+            for (const CatalogFile& file : range) {
+                if (++entriesSinceCheck == kCancellationCheckInterval) {
+                    entriesSinceCheck = 0;
+                    if (cancellation && cancellation->stopRequested()) return Walk::Stopped;
+                }
+                try {
+                    if (inspect(CatalogEntry(current, range.name(file), file), records)) files++;
+                } catch (...) {
+                    // One bad entry must not end the walk
+                }
+            }
+            try {
+                if (!deliver(DirectoryBatch<Record>{current, depth, files, snapshot->childCount(index), records})) {
+                    return Walk::Stopped;
+                }
+            } catch (...) {
+                return Walk::Stopped;
+            }
+        }
+        return Walk::Completed;
+    }
+
+private:
+    struct Root {
+        size_t index = 0;
+        std::string path;
+        std::filesystem::path file;  // empty if not saved
+        std::timed_mutex refreshing;
+        bool unsaved = false;        // guarded by refreshing
+        std::chrono::steady_clock::time_point savedAt;
+        std::mutex mutex;            // guards the fields below
+        std::shared_ptr<const CatalogSnapshot> snapshot;
+        uint64_t generation = 0;
+        std::string lastScope;
+        bool live = false;
+        bool disabled = false;       // too large to catalog
+    };
+
+    std::shared_ptr<const CatalogSnapshot> liveSnapshot(Root& root) {
+        std::lock_guard<std::mutex> lock(root.mutex);
+        return root.live && !root.disabled ? root.snapshot : nullptr;
+    }
+
+    /**
+     * @brief The innermost root containing the directory
+     */
+    Root* rootFor(const std::string& directory) const {
+        Root* best = nullptr;
+        for (const auto& root : roots) {
+            if (contains(root->path, directory) && (!best || root->path.size() > best->path.size())) {
+                best = root.get();
+            }
+        }
+        return best;
+    }
+
+    static bool contains(const std::string& outer, const std::string& inner) {
+        if (inner.compare(0, outer.size(), outer) != 0) return false;
+        if (inner.size() == outer.size()) return true;
+        char last = outer.empty() ? '/' : outer.back();
+        char next = inner[outer.size()];
+        char separator = (char)std::filesystem::path::preferred_separator;
+        return last == '/' || last == separator || next == '/' || next == separator;
+    }
+
+    /**
+     * @brief Refreshes the scope of a root's catalog and returns the result.
+     * A request arriving while the same scope is being refreshed waits and
+     * takes that result. Null if stopped or the tree is too large.
+     */
+    std::shared_ptr<const CatalogSnapshot> refresh(Root& root, const std::string& scope,
+                                                   CancellationToken* cancellation, bool& stopped) {
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(root.mutex);
+            if (root.disabled) return nullptr;
+            seen = root.generation;
+        }
+        while (!root.refreshing.try_lock_for(kCatalogPollInterval)) {
+            if (cancellation && cancellation->stopRequested()) {
+                stopped = true;
+                return nullptr;
+            }
+        }
+        std::lock_guard<std::timed_mutex> held(root.refreshing, std::adopt_lock);
+
+        std::shared_ptr<const CatalogSnapshot> previous;
+        {
+            std::lock_guard<std::mutex> lock(root.mutex);
+            if (root.generation != seen && !root.lastScope.empty() && contains(root.lastScope, scope)) {
+                return root.snapshot;
+            }
+            previous = root.snapshot;
+        }
+
+        // Without the scope's ancestors to copy, refresh from the root
+        std::string effectiveScope = scope;
+        if (!previous || previous->find(scope) == kCatalogNone) effectiveScope = root.path;
+        CatalogTargets targets;
+        targets.subtrees.push_back(effectiveScope);
+        return rebuild(root, previous, std::move(targets), cancellation, true, stopped, effectiveScope);
+    }
+
+    /**
+     * @brief Runs a refresh and publishes its result; call with the root's
+     * refreshing lock held. `scope` is recorded for requests that waited, if
+     * the refresh covers a whole subtree.
+     */
+    std::shared_ptr<const CatalogSnapshot> rebuild(Root& root, const std::shared_ptr<const CatalogSnapshot>& previous,
+                                                   CatalogTargets targets, CancellationToken* cancellation,
+                                                   bool saveNow, bool& stopped, const std::string& scope = "") {
+        auto started = std::chrono::steady_clock::now();
+        CatalogDirectoryHook rootHook;
+        if (hook) {
+            size_t index = root.index;
+            rootHook = [this, index](const std::filesystem::path& directory) { hook(index, directory); };
+        }
+        std::unique_ptr<CatalogRefresh> refresh;
+        CatalogRefresh::Result result = CatalogRefresh::Result::NotPatchable;
+        if (previous && targets.subtrees.empty() && !targets.changed.empty()) {
+            refresh.reset(new CatalogRefresh(previous, targets, cancellation, rootHook));
+            result = refresh->patch();
+        }
+        if (result == CatalogRefresh::Result::NotPatchable) {
+            refresh.reset(new CatalogRefresh(previous, std::move(targets), cancellation, std::move(rootHook)));
+            result = refresh->run(root.path);
+        }
+        if (result == CatalogRefresh::Result::TooLarge) {
+            std::cerr << "The tree below " << root.path << " is too large to catalog; walking it instead" << std::endl;
+            std::lock_guard<std::mutex> lock(root.mutex);
+            root.disabled = true;
+            return nullptr;
+        }
+        if (result == CatalogRefresh::Result::Stopped) {
+            stopped = true;
+            return nullptr;
+        }
+
+        std::shared_ptr<const CatalogSnapshot> next = previous;
+        bool folded = false;
+        if (refresh->changed() || !previous) {
+            next = refresh->patched() ? CatalogSnapshot::withPatches(previous, refresh->takePatches())
+                                      : CatalogSnapshot::fromImage(refresh->image());
+            if (!next) return nullptr;
+            root.unsaved = !root.file.empty();
+            bool saveDue = root.unsaved && (saveNow || started - root.savedAt >= kCatalogSaveInterval);
+            if (next->overlaid() && (saveDue || next->overlaidFiles() > kCatalogMaxOverlayShare * next->fileCount())) {
+                auto flat = next->folded();
+                if (flat) {
+                    next = std::move(flat);
+                    folded = true;
+                }
+            }
+            if (saveDue && next->save(root.file)) {
+                root.unsaved = false;
+                root.savedAt = started;
+                // Mapped back, the catalog lives in the page cache instead
+                // of the heap
+                auto mapped = CatalogSnapshot::load(root.file);
+                if (mapped) next = std::move(mapped);
+            }
+        }
+        long long elapsedMs =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+        std::cout << "Catalog of " << root.path << ": checked " << refresh->directoriesChecked()
+                  << " directories, read " << refresh->directoriesRead() << (refresh->patched() ? ", patched" : "")
+                  << (folded ? ", folded" : "")
+                  << " (" << elapsedMs << " ms)" << std::endl;
+
+        std::lock_guard<std::mutex> lock(root.mutex);
+        root.snapshot = next;
+        root.generation++;
+        root.lastScope = scope;
+        return next;
+    }
+
+    /**
+     * @brief A stable file name for a root's catalog (FNV-1a of its path)
+     */
+    static std::string catalogFileName(const std::string& root) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : root) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.catalog", (unsigned long long)hash);
+        return name;
+    }
+
+    std::vector<std::unique_ptr<Root>> roots;  // fixed once configured
+    DirectoryHook hook;
+};
+
+#endif // DECLUTTER_FILE_CATALOG_HPP
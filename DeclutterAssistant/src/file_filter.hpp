@@ -0,0 +1,677 @@
+#ifndef DECLUTTER_FILE_FILTER_HPP
+#define DECLUTTER_FILE_FILTER_HPP
+
+#include "directory_reader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <pwd.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Cleanup Filters (compiled once, evaluated for every file of a walk)
+// ============================================================================
+//
+// A filter is a list of terms that must all hold, separated by spaces:
+//
+//   ext:tmp,log            extension is one of these (case-insensitive)
+//   name:*.tmp,~*          file name matches one of these globs (* ? [a-z])
+//   path:*/cache/*         full path matches one of these globs
+//   name~^core\.[0-9]+$    file name contains a match of this regex
+//   path~/node_modules/    full path contains a match of this regex
+//   size>1G  size<10K      size bounds (K M G T are powers of 1024)
+//   size:1M..1G            size in [1M, 1G)
+//   mtime<30d              modified before 30 days ago (s m h d w)
+//   atime<2024-01-01       accessed before that day (local time)
+//   ctime>1700000000       status changed after that Unix time
+//   mtime:2024-01-01..7d   modified in that window
+//   owner:alice,1001       owned by one of these users (not on Windows)
+//
+// A term starting with ! is negated, and a value can be put in double
+// quotes to include spaces. Compiling checks the syntax, resolves user
+// names and relative times, and orders the terms by what they cost to
+// evaluate: name checks, then the path (built once into a reused buffer),
+// then one stat for all the fields any term needs, then regexes. Only the
+// regex terms may allocate while a file is evaluated.
+
+// Longer expressions are refused; real policies need a handful of terms
+constexpr size_t kMaxFilterTerms = 32;
+
+/**
+ * @brief The extension of a file name with its dot, as path::extension()
+ * gives it, without building a path
+ */
+inline std::string_view fileExtension(std::string_view name) {
+    size_t dot = name.rfind('.');
+    if (dot == std::string_view::npos || dot == 0) return std::string_view();
+    return name.substr(dot);
+}
+
+/**
+ * @brief Shell-style wildcard match: * any run, ? any character, [abc] [a-z]
+ * [!abc] one of (or none of) a set
+ */
+inline bool globMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    size_t starPattern = std::string_view::npos, starText = 0;
+
+    // Matches the class starting at pattern[p] against c; sets `next` to
+    // the position after the class. A class without its ] is a literal [.
+    auto matchClass = [&pattern](size_t p, char c, size_t& next) {
+        size_t i = p + 1;
+        bool negate = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+        if (negate) i++;
+        bool found = false;
+        bool first = true;
+        for (; i < pattern.size() && (first || pattern[i] != ']'); i++, first = false) {
+            if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                if (c >= pattern[i] && c <= pattern[i + 2]) found = true;
+                i += 2;
+            } else if (pattern[i] == c) {
+                found = true;
+            }
+        }
+        if (i >= pattern.size()) {
+            next = p + 1;
+            return c == '[';
+        }
+        next = i + 1;
+        return found != negate;
+    };
+
+    while (t < text.size()) {
+        if (p < pattern.size()) {
+            char c = pattern[p];
+            if (c == '*') {
+                starPattern = p++;
+                starText = t;
+                continue;
+            }
+            size_t next = p + 1;
+            bool matched = c == '?' || (c == '[' ? matchClass(p, text[t], next) : c == text[t]);
+            if (matched) {
+                p = next;
+                t++;
+                continue;
+            }
+        }
+        // Let the last * swallow one more character and try again
+        if (starPattern == std::string_view::npos) return false;
+        p = starPattern + 1;
+        t = ++starText;
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+class FileFilter {
+public:
+    using FileTime = std::filesystem::file_time_type;
+
+    /**
+     * @brief How far a file got. NameMismatch means it failed a check on its
+     * name alone (e.g. its extension), so nothing else was looked at.
+     */
+    enum class Verdict { NameMismatch, Mismatch, Match };
+
+    /**
+     * @brief What has been read about the entry being evaluated, so several
+     * filters can share one path and one stat. Reset it for each entry; keep
+     * it between entries so its buffer is reused.
+     */
+    struct Evaluation {
+        std::string path;
+        bool havePath = false;
+        EntryStatus status;
+        bool haveStatus = false;
+
+        void reset() {
+            havePath = false;
+            haveStatus = false;
+        }
+    };
+
+    /**
+     * @brief Compiles an expression into `out`. Relative times count back
+     * from `now`. Returns false with a message in `error` if it is invalid.
+     */
+    static bool compile(std::string_view expression, FileFilter& out, std::string& error,
+                        time_t now = time(nullptr)) {
+        out = FileFilter();
+        std::vector<std::string> terms;
+        if (!split(expression, terms, error)) return false;
+        if (terms.size() > kMaxFilterTerms) {
+            error = "Filter has more than " + std::to_string(kMaxFilterTerms) + " terms";
+            return false;
+        }
+        for (const std::string& term : terms) {
+            if (!out.addTerm(term, now, error)) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Adds the "fileType" criterion of the classic cleanup request;
+     * an empty type matches files without an extension
+     */
+    void requireExtension(std::string_view type) {
+        Check check;
+        check.kind = Kind::Extension;
+        check.patterns.push_back(normalizeExtension(type));
+        add(std::move(check), "ext:" + std::string(type));
+    }
+
+    /**
+     * @brief Adds the "beforeTimestamp" criterion of the classic cleanup
+     * request: last modified before that Unix time
+     */
+    void requireModifiedBefore(time_t timestamp) {
+        Check check;
+        check.kind = Kind::Modified;
+        check.highTime = fileTimeFromTimeT(timestamp);
+        add(std::move(check), "mtime<" + std::to_string((long long)timestamp));
+    }
+
+    bool empty() const {
+        return checks.empty();
+    }
+
+    /**
+     * @brief The terms as compiled, one space apart; equal texts select the
+     * same files
+     */
+    const std::string& text() const {
+        return canonical;
+    }
+
+    /**
+     * @brief StatField values evaluate() reads
+     */
+    unsigned statFields() const {
+        return fields;
+    }
+
+    /**
+     * @brief Evaluates the filter for one entry. `extraFields` are read in
+     * the same stat as the filter's own, into `state.status`, if the entry
+     * gets that far (always, for a Match). Filters sharing a state must pass
+     * the same extraFields, covering all of their statFields().
+     *
+     * `Entry` is a WalkEntry, or anything with its name(), appendPath() and
+     * status() (e.g. a CatalogEntry).
+     */
+    template <typename Entry>
+    Verdict evaluate(const Entry& entry, unsigned extraFields, Evaluation& state) const {
+        std::string_view name = entry.name();
+        for (const Check& check : checks) {
+            bool pass = false;
+            switch (check.kind) {
+                case Kind::Extension: {
+                    std::string_view extension = fileExtension(name);
+                    for (const std::string& wanted : check.patterns) {
+                        if (equalsLowercase(extension, wanted)) {
+                            pass = true;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case Kind::NameGlob:
+                    pass = anyGlob(check.patterns, name);
+                    break;
+                case Kind::PathGlob:
+                    buildPath(entry, state);
+                    pass = anyGlob(check.patterns, state.path);
+                    break;
+                case Kind::Size:
+                case Kind::Modified:
+                case Kind::Accessed:
+                case Kind::Changed:
+                case Kind::Owner:
+                    if (!readStatus(entry, fields | extraFields, state)) return Verdict::Mismatch;
+                    pass = statusPasses(check, state.status);
+                    break;
+                case Kind::NameRegex:
+                    pass = std::regex_search(name.begin(), name.end(), *check.regex);
+                    break;
+                case Kind::PathRegex:
+                    buildPath(entry, state);
+                    pass = std::regex_search(state.path.begin(), state.path.end(), *check.regex);
+                    break;
+            }
+            if (pass == check.negate) {
+                return check.kind <= Kind::NameGlob ? Verdict::NameMismatch : Verdict::Mismatch;
+            }
+        }
+        if (extraFields != 0 && !readStatus(entry, fields | extraFields, state)) return Verdict::Mismatch;
+        return Verdict::Match;
+    }
+
+    /**
+     * @brief Describes the name checks for messages, e.g. "with extension
+     * .log"; empty if there are none
+     */
+    std::string describeNameChecks() const {
+        std::string described;
+        for (const Check& check : checks) {
+            if (check.kind > Kind::NameGlob) break;
+            if (check.kind == Kind::Extension && !check.negate && check.patterns.size() == 1 && described.empty()) {
+                described = "with extension " + check.patterns[0];
+                continue;
+            }
+            described += described.empty() ? "matching " : " ";
+            described += check.term;
+        }
+        return described;
+    }
+
+    /**
+     * @brief Describes what files passing the name checks still have to do,
+     * e.g. "are older than the specified date"
+     */
+    std::string describeOtherChecks() const {
+        const Check* only = nullptr;
+        for (const Check& check : checks) {
+            if (check.kind <= Kind::NameGlob) continue;
+            if (only) return "match the rest of the filter";
+            only = &check;
+        }
+        if (only && only->kind == Kind::Modified && !only->negate && only->lowTime == FileTime::min()) {
+            return "are older than the specified date";
+        }
+        return "match the rest of the filter";
+    }
+
+private:
+    // In the order they are evaluated: cheapest first
+    enum class Kind { Extension, NameGlob, PathGlob, Size, Modified, Accessed, Changed, Owner, NameRegex, PathRegex };
+
+    struct Check {
+        Kind kind = Kind::Extension;
+        bool negate = false;
+        std::string term;                   // as written, for messages
+        std::vector<std::string> patterns;  // extensions (lowercase, with dot) or globs
+        uintmax_t lowSize = 0;              // inclusive
+        uintmax_t highSize = std::numeric_limits<uintmax_t>::max();  // exclusive
+        FileTime lowTime = FileTime::min();                          // inclusive
+        FileTime highTime = FileTime::max();                         // exclusive
+        std::vector<unsigned long> owners;
+        std::shared_ptr<const std::regex> regex;
+    };
+
+    /**
+     * @brief Splits on spaces, keeping quoted runs together (quotes removed)
+     */
+    static bool split(std::string_view expression, std::vector<std::string>& terms, std::string& error) {
+        std::string current;
+        bool inTerm = false, quoted = false;
+        for (char c : expression) {
+            if (c == '"') {
+                quoted = !quoted;
+                inTerm = true;
+            } else if (!quoted && (c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
+                if (inTerm) terms.push_back(std::move(current));
+                current.clear();
+                inTerm = false;
+            } else {
+                current += c;
+                inTerm = true;
+            }
+        }
+        if (quoted) {
+            error = "Unterminated quote in filter";
+            return false;
+        }
+        if (inTerm) terms.push_back(std::move(current));
+        return true;
+    }
+
+    bool addTerm(std::string_view term, time_t now, std::string& error) {
+        Check check;
+        check.negate = !term.empty() && term[0] == '!';
+        std::string_view body = check.negate ? term.substr(1) : term;
+
+        size_t op = body.find_first_of(":~<>");
+        if (op == std::string_view::npos || op == 0) {
+            error = "Filter term \"" + std::string(term) + "\" needs a field and a value, e.g. ext:log";
+            return false;
+        }
+        std::string_view key = body.substr(0, op);
+        char kind = body[op];
+        std::string_view value = body.substr(op + 1);
+        auto invalid = [&](const std::string& why) {
+            error = "Invalid filter term \"" + std::string(term) + "\": " + why;
+            return false;
+        };
+
+        if (key == "ext") {
+            if (kind != ':') return invalid("use ext:a,b");
+            check.kind = Kind::Extension;
+            if (!forEachListItem(value, [&](std::string_view item) {
+                    check.patterns.push_back(normalizeExtension(item));
+                })) {
+                return invalid("empty extension in the list");
+            }
+        } else if (key == "name" || key == "path") {
+            bool isName = key == "name";
+            if (kind == ':') {
+                check.kind = isName ? Kind::NameGlob : Kind::PathGlob;
+                if (!forEachListItem(value, [&](std::string_view item) { check.patterns.emplace_back(item); })) {
+                    return invalid("empty pattern in the list");
+                }
+            } else if (kind == '~') {
+                check.kind = isName ? Kind::NameRegex : Kind::PathRegex;
+                try {
+                    check.regex = std::make_shared<const std::regex>(std::string(value),
+                                                                     std::regex::ECMAScript | std::regex::optimize);
+                } catch (const std::regex_error& e) {
+                    return invalid(std::string("bad regex (") + e.what() + ")");
+                }
+            } else {
+                return invalid("use " + std::string(key) + ":glob or " + std::string(key) + "~regex");
+            }
+        } else if (key == "size") {
+            check.kind = Kind::Size;
+            if (!parseBounds(kind, value, check.lowSize, check.highSize, parseSize)) {
+                return invalid("expected size>N, size<N, size:N or size:N..M with an optional K, M, G or T");
+            }
+        } else if (key == "mtime" || key == "atime" || key == "ctime") {
+            check.kind = key == "mtime" ? Kind::Modified : key == "atime" ? Kind::Accessed : Kind::Changed;
+            time_t low = std::numeric_limits<time_t>::min(), high = std::numeric_limits<time_t>::max();
+            auto parse = [now](std::string_view text, time_t& out, bool upper) {
+                return parseTime(text, now, out, upper);
+            };
+            if (!parseBounds(kind, value, low, high, parse)) {
+                return invalid("expected a Unix time, a date (YYYY-MM-DD) or an age such as 30d, after < > or :");
+            }
+            // A single age names a whole unit: mtime:30d is 30 to 31 days ago
+            long long unit = ageUnit(value);
+            if (kind == ':' && unit > 0) low = high - (time_t)unit;
+            if (low != std::numeric_limits<time_t>::min()) check.lowTime = fileTimeFromTimeT(low);
+            if (high != std::numeric_limits<time_t>::max()) check.highTime = fileTimeFromTimeT(high);
+        } else if (key == "owner") {
+            if (kind != ':') return invalid("use owner:name,uid");
+            check.kind = Kind::Owner;
+            bool resolved = true;
+            bool complete = forEachListItem(value, [&](std::string_view item) {
+                unsigned long uid = 0;
+                if (resolveOwner(item, uid)) {
+                    check.owners.push_back(uid);
+                } else {
+                    resolved = false;
+                }
+            });
+            if (!complete) return invalid("empty user in the list");
+            if (!resolved) return invalid("unknown user");
+        } else {
+            return invalid("unknown field; use ext, name, path, size, mtime, atime, ctime or owner");
+        }
+
+        unsigned needs = statFieldsOf(check.kind);
+        if (!statFieldsSupported(needs)) return invalid("not supported on this platform");
+        add(std::move(check), std::string(term));
+        return true;
+    }
+
+    void add(Check check, std::string term) {
+        fields |= statFieldsOf(check.kind);
+        check.term = std::move(term);
+        if (!canonical.empty()) canonical += ' ';
+        canonical += check.term;
+        // Stable, so equal kinds keep the order they were written in
+        auto position = std::upper_bound(checks.begin(), checks.end(), check.kind,
+                                         [](Kind kind, const Check& other) { return kind < other.kind; });
+        checks.insert(position, std::move(check));
+    }
+
+    static unsigned statFieldsOf(Kind kind) {
+        switch (kind) {
+            case Kind::Size: return kStatSize;
+            case Kind::Modified: return kStatModified;
+            case Kind::Accessed: return kStatAccessed;
+            case Kind::Changed: return kStatChanged;
+            case Kind::Owner: return kStatOwner;
+            default: return 0;
+        }
+    }
+
+    static bool statusPasses(const Check& check, const EntryStatus& status) {
+        switch (check.kind) {
+            case Kind::Size: return status.size >= check.lowSize && status.size < check.highSize;
+            case Kind::Modified: return status.modified >= check.lowTime && status.modified < check.highTime;
+            case Kind::Accessed: return status.accessed >= check.lowTime && status.accessed < check.highTime;
+            case Kind::Changed: return status.changed >= check.lowTime && status.changed < check.highTime;
+            case Kind::Owner:
+                return std::find(check.owners.begin(), check.owners.end(), status.owner) != check.owners.end();
+            default: return false;
+        }
+    }
+
+    template <typename Entry>
+    static void buildPath(const Entry& entry, Evaluation& state) {
+        if (state.havePath) return;
+        state.path.clear();
+        entry.appendPath(state.path);
+        state.havePath = true;
+    }
+
+    template <typename Entry>
+    static bool readStatus(const Entry& entry, unsigned fields, Evaluation& state) {
+        if (!state.haveStatus) {
+            if (!entry.status(fields, state.status)) return false;
+            state.haveStatus = true;
+        }
+        return true;
+    }
+
+    static bool anyGlob(const std::vector<std::string>& patterns, std::string_view text) {
+        for (const std::string& pattern : patterns) {
+            if (globMatch(pattern, text)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief `text` equals `lowercase` ignoring the case of `text`
+     */
+    static bool equalsLowercase(std::string_view text, std::string_view lowercase) {
+        if (text.size() != lowercase.size()) return false;
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+            if (c != lowercase[i]) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Lowercase with a leading dot, as the scans compare extensions
+     */
+    static std::string normalizeExtension(std::string_view type) {
+        std::string normalized;
+        if (!type.empty() && type[0] != '.') normalized += '.';
+        normalized += type;
+        for (char& c : normalized) {
+            if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        }
+        return normalized;
+    }
+
+    /**
+     * @brief Calls onItem for each item of a comma-separated list. False,
+     * before any call, if an item is empty (as in "", "a," or "a,,b").
+     */
+    template <typename Callback>
+    static bool forEachListItem(std::string_view list, Callback&& onItem) {
+        if (list.empty() || list.front() == ',' || list.back() == ',' || list.find(",,") != std::string_view::npos) {
+            return false;
+        }
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t comma = list.find(',', start);
+            if (comma == std::string_view::npos) comma = list.size();
+            onItem(list.substr(start, comma - start));
+            start = comma + 1;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Parses "<N", ">N", ":N" or ":N..M" into [low, high). A single
+     * value after ':' selects the unit it names (a byte, a day...).
+     */
+    template <typename T, typename Parse>
+    static bool parseBounds(char kind, std::string_view value, T& low, T& high, const Parse& parse) {
+        if (kind == '<') return parse(value, high, false);
+        if (kind == '>') {
+            // Strictly greater: one unit above the value
+            T bound;
+            if (!parse(value, bound, true)) return false;
+            low = bound;
+            return true;
+        }
+        if (kind != ':') return false;
+        size_t dots = value.find("..");
+        if (dots == std::string_view::npos) {
+            return parse(value, low, false) && parse(value, high, true);
+        }
+        return parse(value.substr(0, dots), low, false) && parse(value.substr(dots + 2), high, false) && low <= high;
+    }
+
+    /**
+     * @brief A byte count such as 512, 10K or 1.5G; `upper` gives the first
+     * value past it (for > and for single values)
+     */
+    static bool parseSize(std::string_view text, uintmax_t& out, bool upper) {
+        if (!text.empty() && (text.back() == 'B' || text.back() == 'b')) text.remove_suffix(1);
+        if (text.size() >= 2 && (text.back() == 'i')) text.remove_suffix(1);
+        uintmax_t unit = 1;
+        if (!text.empty()) {
+            switch (text.back()) {
+                case 'k': case 'K': unit = 1ull << 10; break;
+                case 'm': case 'M': unit = 1ull << 20; break;
+                case 'g': case 'G': unit = 1ull << 30; break;
+                case 't': case 'T': unit = 1ull << 40; break;
+                default: break;
+            }
+            if (unit != 1) text.remove_suffix(1);
+        }
+        size_t dot = text.find('.');
+        std::string_view whole = text.substr(0, dot);
+        std::string_view fraction = dot == std::string_view::npos ? std::string_view() : text.substr(dot + 1);
+        uintmax_t integer = 0;
+        if (whole.empty() || std::from_chars(whole.data(), whole.data() + whole.size(), integer).ptr !=
+                                 whole.data() + whole.size()) {
+            return false;
+        }
+        if (integer > std::numeric_limits<uintmax_t>::max() / unit) return false;
+        uintmax_t bytes = integer * unit;
+        uintmax_t scale = unit;
+        for (char digit : fraction) {
+            if (digit < '0' || digit > '9') return false;
+            scale /= 10;
+            bytes += (uintmax_t)(digit - '0') * scale;
+        }
+        out = upper ? bytes + 1 : bytes;
+        return true;
+    }
+
+    /**
+     * @brief The seconds in the unit of an age such as 30d; 0 if `text` is
+     * not an age
+     */
+    static long long ageUnit(std::string_view text) {
+        if (text.size() < 2) return 0;
+        for (size_t i = 0; i + 1 < text.size(); i++) {
+            if (text[i] < '0' || text[i] > '9') return 0;
+        }
+        switch (text.back()) {
+            case 's': return 1;
+            case 'm': return 60;
+            case 'h': return 3600;
+            case 'd': return 86400;
+            case 'w': return 7 * 86400;
+            default: return 0;
+        }
+    }
+
+    /**
+     * @brief A Unix time, a local date (YYYY-MM-DD) or an age before `now`
+     * (30d, 12h, 2w, 15m, 90s). `upper` gives the end of the second or day
+     * it names.
+     */
+    static bool parseTime(std::string_view text, time_t now, time_t& out, bool upper) {
+        if (text.empty()) return false;
+        long long number = 0;
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), number);
+        if (parsed.ec != std::errc() || number < 0) return false;
+        size_t rest = parsed.ptr - text.data();
+
+        if (rest == text.size()) {
+            out = (time_t)number + (upper ? 1 : 0);
+            return true;
+        }
+        if (rest == text.size() - 1) {
+            long long unit = ageUnit(text);
+            if (unit == 0) return false;
+            out = now - (time_t)(number * unit) + (upper ? 1 : 0);
+            return true;
+        }
+        if (text.size() == 10 && text[4] == '-' && text[7] == '-') {
+            int year = 0, month = 0, day = 0;
+            const char* end = text.data() + text.size();
+            if (std::from_chars(text.data(), text.data() + 4, year).ptr != text.data() + 4 ||
+                std::from_chars(text.data() + 5, text.data() + 7, month).ptr != text.data() + 7 ||
+                std::from_chars(text.data() + 8, end, day).ptr != end || month < 1 || month > 12 || day < 1 ||
+                day > 31) {
+                return false;
+            }
+            struct tm date = {};
+            date.tm_year = year - 1900;
+            date.tm_mon = month - 1;
+            date.tm_mday = day + (upper ? 1 : 0);
+            date.tm_isdst = -1;
+            time_t local = mktime(&date);
+            if (local == (time_t)-1) return false;
+            out = local;
+            return true;
+        }
+        return false;
+    }
+
+    static bool resolveOwner(std::string_view name, unsigned long& uid) {
+        if (name.empty()) return false;
+        auto parsed = std::from_chars(name.data(), name.data() + name.size(), uid);
+        if (parsed.ec == std::errc() && parsed.ptr == name.data() + name.size()) return true;
+#ifdef _WIN32
+        return false;
+#else
+        struct passwd entry;
+        struct passwd* found = nullptr;
+        std::vector<char> buffer(16384);
+        if (getpwnam_r(std::string(name).c_str(), &entry, buffer.data(), buffer.size(), &found) != 0 || !found) {
+            return false;
+        }
+        uid = found->pw_uid;
+        return true;
+#endif
+    }
+
+    std::vector<Check> checks;  // sorted by Kind
+    std::string canonical;
+    unsigned fields = 0;
+};
+
+#endif // DECLUTTER_FILE_FILTER_HPP
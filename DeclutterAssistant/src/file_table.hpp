@@ -0,0 +1,200 @@
+#ifndef DECLUTTER_FILE_TABLE_HPP
+#define DECLUTTER_FILE_TABLE_HPP
+
+#include "file_filter.hpp"
+#include "path_tree.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// File Tables (matched files, one column per field)
+// ============================================================================
+//
+// Scans can match millions of files, and each is kept until its cleanup.
+// Instead of an object with its own path string per file, a table keeps
+// one array per field: the directory (a node of the table's path tree),
+// where the name starts in one shared buffer of names, the size, the
+// modification time and the extension (an index into the table's distinct
+// extensions). That is 26 bytes plus the name itself per file, without a
+// heap block of its own; the full path is put together only when it is
+// needed.
+//
+// Rows are only ever appended, so a row's name ends where the next begins.
+
+/**
+ * @brief A file as the walking threads collect it; the directory comes with
+ * its batch
+ */
+struct FileRow {
+    std::string name;
+    uintmax_t size;
+    std::filesystem::file_time_type modified;
+};
+
+class FileTable {
+public:
+    // Extensions past the first 65535 distinct ones all share this id
+    static constexpr uint16_t kOtherExtension = UINT16_MAX;
+
+    FileTable() : identity(nextIdentity()) {}
+
+    /**
+     * @brief The directory to add rows of, by its full path
+     */
+    uint32_t addDirectory(std::string_view path) {
+        return paths.intern(path);
+    }
+
+    void add(uint32_t directory, std::string_view name, uintmax_t size, std::filesystem::file_time_type modified) {
+        if (names.size() + name.size() > UINT32_MAX) throw std::length_error("Too many matched files");
+        directories.push_back(directory);
+        nameOffsets.push_back((uint32_t)names.size());
+        names.append(name);
+        sizes.push_back(size);
+        modifiedTimes.push_back(modified.time_since_epoch().count());
+        extensions.push_back(internExtension(fileExtension(name)));
+    }
+
+    /**
+     * @brief Appends a row of another table
+     */
+    void add(const FileTable& from, size_t row) {
+        // Rows tend to come a directory at a time, so its path is looked up
+        // once for all of them
+        uint32_t directory = from.directory(row);
+        if (copied.identity != from.identity || copied.from != directory) {
+            copied = Copied{from.identity, directory, addDirectory(from.paths.path(directory))};
+        }
+        add(copied.to, from.name(row), from.size(row), from.modified(row));
+    }
+
+    size_t size() const {
+        return sizes.size();
+    }
+
+    bool empty() const {
+        return sizes.empty();
+    }
+
+    void clear() {
+        directories.clear();
+        nameOffsets.clear();
+        sizes.clear();
+        modifiedTimes.clear();
+        extensions.clear();
+        names.clear();
+        paths.clear();
+        identity = nextIdentity();
+    }
+
+    /**
+     * @brief Gives back the room kept for more rows, for a table that is
+     * kept but no longer grows
+     */
+    void compact() {
+        directories.shrink_to_fit();
+        nameOffsets.shrink_to_fit();
+        sizes.shrink_to_fit();
+        modifiedTimes.shrink_to_fit();
+        extensions.shrink_to_fit();
+        names.shrink_to_fit();
+        paths.freeze();
+    }
+
+    uint32_t directory(size_t row) const {
+        return directories[row];
+    }
+
+    std::string directoryPath(uint32_t directory) const {
+        return paths.path(directory);
+    }
+
+    std::string_view name(size_t row) const {
+        size_t end = row + 1 < nameOffsets.size() ? nameOffsets[row + 1] : names.size();
+        return std::string_view(names).substr(nameOffsets[row], end - nameOffsets[row]);
+    }
+
+    uintmax_t size(size_t row) const {
+        return sizes[row];
+    }
+
+    std::filesystem::file_time_type modified(size_t row) const {
+        return std::filesystem::file_time_type(std::filesystem::file_time_type::duration(modifiedTimes[row]));
+    }
+
+    /**
+     * @brief Equal for rows with the same extension, except kOtherExtension
+     */
+    uint16_t extensionId(size_t row) const {
+        return extensions[row];
+    }
+
+    std::string_view extension(size_t row) const {
+        if (extensions[row] == kOtherExtension) return fileExtension(name(row));
+        return extensionNames[extensions[row]];
+    }
+
+    void appendPath(size_t row, std::string& out) const {
+        paths.appendPath(directories[row], out);
+        char separator = (char)std::filesystem::path::preferred_separator;
+        if (!out.empty() && out.back() != separator && out.back() != '/') out += separator;
+        out += name(row);
+    }
+
+    std::string path(size_t row) const {
+        std::string out;
+        appendPath(row, out);
+        return out;
+    }
+
+private:
+    // Which rows of which table add() last copied, and their directory here
+    struct Copied {
+        uint64_t identity = 0;
+        uint32_t from = PathTree::kNone;
+        uint32_t to = PathTree::kNone;
+    };
+
+    // Tells tables apart, and a table from itself before it was cleared
+    static uint64_t nextIdentity() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    uint16_t internExtension(std::string_view extension) {
+        // Files of a directory tend to share their extension
+        if (!extensions.empty() && extensions.back() != kOtherExtension &&
+            extensionNames[extensions.back()] == extension) {
+            return extensions.back();
+        }
+        auto it = extensionIds.find(std::string(extension));
+        if (it != extensionIds.end()) return it->second;
+        if (extensionNames.size() == kOtherExtension) return kOtherExtension;
+        extensionNames.emplace_back(extension);
+        extensionIds.emplace(extensionNames.back(), (uint16_t)(extensionNames.size() - 1));
+        return (uint16_t)(extensionNames.size() - 1);
+    }
+
+    // The columns, one entry per row
+    std::vector<uint32_t> directories;
+    std::vector<uint32_t> nameOffsets;
+    std::vector<uint64_t> sizes;
+    std::vector<std::filesystem::file_time_type::rep> modifiedTimes;
+    std::vector<uint16_t> extensions;
+
+    std::string names;  // every row's name, back to back
+    PathTree paths;     // the rows' directories
+    std::vector<std::string> extensionNames;
+    std::unordered_map<std::string, uint16_t> extensionIds;
+    uint64_t identity;
+    Copied copied;
+};
+
+#endif // DECLUTTER_FILE_TABLE_HPP
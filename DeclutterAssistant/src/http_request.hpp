@@ -0,0 +1,367 @@
+#ifndef DECLUTTER_HTTP_REQUEST_HPP
+#define DECLUTTER_HTTP_REQUEST_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// ============================================================================
+// HTTP Request Model and Incremental Body Decoding
+// ============================================================================
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+constexpr size_t kMaxBodyBytes = 64 * 1024 * 1024;
+
+// Bodies above this size (and all chunked bodies) are streamed to the
+// handler while they arrive instead of being buffered first
+constexpr size_t kStreamBodyThreshold = 256 * 1024;
+
+// Reading from the socket pauses while this much streamed body is unread
+constexpr size_t kBodyStreamHighWater = 1024 * 1024;
+
+/**
+ * @brief Finds a header in a request head (case-insensitive name, given in
+ * lowercase). Returns false if the header is absent. The value is a view
+ * into `head`.
+ */
+inline bool findHeader(std::string_view head, const char* lowerName, std::string_view& value) {
+    size_t lineStart = head.find("\r\n");
+    while (lineStart != std::string_view::npos && lineStart + 2 < head.size()) {
+        lineStart += 2;
+        size_t lineEnd = head.find("\r\n", lineStart);
+        if (lineEnd == std::string_view::npos) lineEnd = head.size();
+
+        size_t i = 0;
+        while (lowerName[i] && lineStart + i < lineEnd &&
+               tolower((unsigned char)head[lineStart + i]) == lowerName[i]) i++;
+        if (!lowerName[i] && lineStart + i < lineEnd && head[lineStart + i] == ':') {
+            size_t pos = lineStart + i + 1;
+            while (pos < lineEnd && (head[pos] == ' ' || head[pos] == '\t')) pos++;
+            size_t end = lineEnd;
+            while (end > pos && (head[end - 1] == ' ' || head[end - 1] == '\t')) end--;
+            value = head.substr(pos, end - pos);
+            return true;
+        }
+        lineStart = lineEnd;
+    }
+    return false;
+}
+
+inline bool findHeaderValue(const std::string& head, const char* lowerName, std::string& value) {
+    std::string_view view;
+    if (!findHeader(head, lowerName, view)) return false;
+    value.assign(view.data(), view.size());
+    return true;
+}
+
+/**
+ * @brief Returns the Content-Length of a request head, 0 if absent, or -1
+ * if the header is malformed.
+ */
+inline long long parseContentLength(const std::string& head) {
+    std::string value;
+    if (!findHeaderValue(head, "content-length", value)) return 0;
+    if (value.empty() || !isdigit((unsigned char)value[0])) return -1;
+    char* end = nullptr;
+    errno = 0;
+    long long length = strtoll(value.c_str(), &end, 10);
+    if (*end != '\0' || errno == ERANGE) return -1;
+    return length;
+}
+
+inline bool hasContentLength(const std::string& head) {
+    std::string_view value;
+    return findHeader(head, "content-length", value);
+}
+
+inline bool isChunkedBody(const std::string& head) {
+    std::string value;
+    if (!findHeaderValue(head, "transfer-encoding", value)) return false;
+    for (auto& c : value) c = (char)tolower((unsigned char)c);
+    return value.find("chunked") != std::string::npos;
+}
+
+/**
+ * @brief HTTP/1.1 keeps the connection open unless the client sends
+ * "Connection: close"; HTTP/1.0 only if it asks for keep-alive.
+ */
+inline bool wantsKeepAlive(const std::string& head) {
+    size_t lineEnd = head.find("\r\n");
+    bool http10 = lineEnd != std::string::npos && lineEnd >= 8 &&
+                  head.compare(lineEnd - 8, 8, "HTTP/1.0") == 0;
+
+    std::string connection;
+    if (findHeaderValue(head, "connection", connection)) {
+        for (auto& c : connection) c = (char)tolower((unsigned char)c);
+        if (connection.find("close") != std::string::npos) return false;
+        if (connection.find("keep-alive") != std::string::npos) return true;
+    }
+    return !http10;
+}
+
+/**
+ * @brief Bounded hand-off of a request body from the I/O thread to the
+ * worker running the handler.
+ *
+ * The I/O thread push()es decoded pieces and pauses reading the socket when
+ * push() reports the buffer is full; the worker's read() resumes it once the
+ * backlog has drained.
+ */
+class BodyStream {
+public:
+    /**
+     * @brief Called on the worker thread when a paused producer may resume
+     */
+    void setResumeCallback(std::function<void()> callback) {
+        std::lock_guard<std::mutex> lock(mutex);
+        onResume = std::move(callback);
+    }
+
+    /**
+     * @brief Producer side. Returns false if the producer should pause.
+     */
+    bool push(std::string data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffered += data.size();
+        pieces.push_back(std::move(data));
+        available.notify_one();
+        if (buffered >= kBodyStreamHighWater) {
+            producerPaused = true;
+            return false;
+        }
+        return true;
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        available.notify_all();
+    }
+
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+        finished = true;
+        available.notify_all();
+    }
+
+    /**
+     * @brief Consumer side. Blocks for the next piece; returns false at the
+     * end of the body or if the connection went away.
+     */
+    bool read(std::string& piece) {
+        std::function<void()> resume;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return !pieces.empty() || finished; });
+            if (aborted || pieces.empty()) return false;
+
+            piece = std::move(pieces.front());
+            pieces.pop_front();
+            buffered -= piece.size();
+            if (producerPaused && buffered < kBodyStreamHighWater / 2) {
+                producerPaused = false;
+                resume = onResume;
+            }
+        }
+        if (resume) resume();
+        return true;
+    }
+
+    bool wasAborted() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return aborted;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::string> pieces;
+    std::function<void()> onResume;
+    size_t buffered = 0;
+    bool producerPaused = false;
+    bool finished = false;
+    bool aborted = false;
+};
+
+/**
+ * @brief Incremental decoder for Content-Length and chunked bodies.
+ * Consumes raw bytes from the socket buffer and appends decoded body bytes.
+ */
+class BodyDecoder {
+public:
+    void startLength(unsigned long long length) {
+        chunked = false;
+        remaining = length;
+        state = length == 0 ? State::Done : State::Data;
+    }
+
+    void startChunked() {
+        chunked = true;
+        remaining = 0;
+        totalChunked = 0;
+        line.clear();
+        state = State::ChunkSize;
+    }
+
+    bool done() const {
+        return state == State::Done;
+    }
+
+    bool failed() const {
+        return state == State::Error;
+    }
+
+    /**
+     * @brief Decodes from data[0, len); returns the number of bytes consumed.
+     * Stops early once the body is complete or the output reaches maxOut.
+     */
+    size_t decode(const char* data, size_t len, std::string& out, size_t maxOut) {
+        size_t pos = 0;
+        while (pos < len && state != State::Done && state != State::Error && out.size() < maxOut) {
+            switch (state) {
+                case State::Data: {
+                    size_t take = (size_t)std::min<unsigned long long>(remaining, len - pos);
+                    take = std::min(take, maxOut - out.size());
+                    out.append(data + pos, take);
+                    pos += take;
+                    remaining -= take;
+                    if (remaining == 0) state = chunked ? State::ChunkDataEnd : State::Done;
+                    break;
+                }
+                case State::ChunkSize:
+                case State::ChunkDataEnd:
+                case State::Trailer: {
+                    char c = data[pos++];
+                    if (c != '\n') {
+                        if (c != '\r') line += c;
+                        if (line.size() > 1024) state = State::Error;
+                        break;
+                    }
+                    finishLine();
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        return pos;
+    }
+
+private:
+    enum class State { ChunkSize, Data, ChunkDataEnd, Trailer, Done, Error };
+
+    void finishLine() {
+        if (state == State::ChunkSize) {
+            // Chunk extensions after ';' are ignored. strtoull would also
+            // take a sign or leading space, and clamps what does not fit.
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long size = strtoull(line.c_str(), &end, 16);
+            bool valid = !line.empty() && isxdigit((unsigned char)line[0]) && errno != ERANGE &&
+                         (*end == '\0' || *end == ';' || *end == ' ' || *end == '\t');
+            if (!valid || size > kMaxBodyBytes - totalChunked) {
+                state = State::Error;
+            } else if (size == 0) {
+                state = State::Trailer;
+            } else {
+                totalChunked += size;
+                remaining = size;
+                state = State::Data;
+            }
+        } else if (state == State::ChunkDataEnd) {
+            state = line.empty() ? State::ChunkSize : State::Error;
+        } else if (state == State::Trailer) {
+            if (line.empty()) state = State::Done;
+        }
+        line.clear();
+    }
+
+    State state = State::Done;
+    bool chunked = false;
+    unsigned long long remaining = 0;
+    unsigned long long totalChunked = 0;
+    std::string line;
+};
+
+/**
+ * @brief A parsed request. Small bodies arrive in `body`; large and chunked
+ * bodies are delivered through `bodyStream` while they are still uploading.
+ */
+struct HttpRequest {
+    std::string method;
+    std::string target;  // path and query string
+    std::string head;    // request line and headers, CRLF terminated
+    std::string body;
+    std::shared_ptr<BodyStream> bodyStream;
+    bool keepAlive = true;
+
+    /**
+     * @brief Parses the request line of `head`. Returns false if malformed.
+     */
+    bool parseRequestLine() {
+        size_t lineEnd = head.find("\r\n");
+        size_t methodEnd = head.find(' ');
+        if (lineEnd == std::string::npos || methodEnd == std::string::npos || methodEnd > lineEnd) return false;
+        size_t targetEnd = head.find(' ', methodEnd + 1);
+        if (targetEnd == std::string::npos || targetEnd > lineEnd) return false;
+        method = head.substr(0, methodEnd);
+        target = head.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        return !method.empty() && !target.empty();
+    }
+
+    std::string header(const char* lowerName) const {
+        std::string value;
+        findHeaderValue(head, lowerName, value);
+        return value;
+    }
+
+    /**
+     * @brief Like header(), but returns a view into `head` without copying
+     */
+    std::string_view headerView(const char* lowerName) const {
+        std::string_view value;
+        findHeader(head, lowerName, value);
+        return value;
+    }
+
+    /**
+     * @brief Yields the body piece by piece; returns false when exhausted.
+     * Works the same for buffered and streamed bodies.
+     */
+    bool nextBodyChunk(std::string& chunk) const {
+        if (bodyStream) return bodyStream->read(chunk);
+        if (bodyTaken || body.empty()) return false;
+        bodyTaken = true;
+        chunk = body;
+        return true;
+    }
+
+    /**
+     * @brief Returns the whole body, draining the stream if there is one.
+     * Meant for endpoints with small JSON bodies.
+     */
+    std::string readBody() const {
+        if (!bodyStream) return body;
+        std::string all;
+        std::string chunk;
+        while (bodyStream->read(chunk)) {
+            if (all.size() + chunk.size() > kMaxBodyBytes) break;
+            all += chunk;
+        }
+        return all;
+    }
+
+private:
+    mutable bool bodyTaken = false;
+};
+
+#endif // DECLUTTER_HTTP_REQUEST_HPP
@@ -0,0 +1,685 @@
+#ifndef DECLUTTER_HTTP_SERVER_HPP
+#define DECLUTTER_HTTP_SERVER_HPP
+
+#include "event_loop.hpp"
+#include "http_request.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// ============================================================================
+// HTTP Front End (non-blocking connections on a few I/O threads)
+// ============================================================================
+
+class Connection;
+
+/**
+ * @brief A response as a small header block plus the body. The two are
+ * queued as separate buffers and written with one vectored send, so the
+ * body is never copied into a combined string.
+ */
+struct HttpResponse {
+    std::string head;
+    std::string body;
+};
+
+using RequestCallback = std::function<void(const std::shared_ptr<Connection>&, HttpRequest)>;
+
+/**
+ * @brief Takes over a connection after a protocol upgrade (e.g. WebSocket).
+ * Both callbacks run on the connection's loop thread.
+ */
+class ProtocolHandler {
+public:
+    virtual ~ProtocolHandler() = default;
+
+    /**
+     * @brief Consumes what it can from the buffered input; bytes it leaves
+     * in `input` are offered again when more data arrives.
+     */
+    virtual void onInput(std::string& input) = 0;
+
+    virtual void onClosed() = 0;
+};
+
+/**
+ * @brief Per-loop state shared by the connections assigned to that loop
+ */
+struct ConnectionContext {
+    EventLoop loop;
+    const RequestCallback* onRequest = nullptr;
+    std::unordered_set<Connection*> connections;  // loop thread only
+};
+
+/**
+ * @brief One client connection, owned by the event loop it was assigned to.
+ *
+ * Socket state is only touched on the loop thread. Workers interact through
+ * send(), finishRequest() and close(), which post to the loop and are safe
+ * from any thread.
+ *
+ * Input is parsed incrementally: a request with a small body is dispatched
+ * once it is complete, while large or chunked bodies are dispatched as soon
+ * as the head arrives and then streamed through a BodyStream. Pipelined
+ * requests are buffered and dispatched one at a time, so responses always
+ * go out in request order.
+ */
+class Connection : public IoWatcher, public std::enable_shared_from_this<Connection> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Connection(ConnectionContext& context, SOCKET fd)
+        : context(context), loop(context.loop), fd(fd), lastActivity(Clock::now()) {}
+
+    ~Connection() override {
+        if (fd != INVALID_SOCKET) closesocket(fd);
+    }
+
+    /**
+     * @brief Queues bytes for the client. Safe to call from any thread.
+     */
+    void send(std::string data) {
+        if (data.empty()) return;
+        queuedBytes += data.size();
+        auto self = shared_from_this();
+        loop.post([self, data = std::move(data)]() mutable {
+            if (self->fd == INVALID_SOCKET) return;
+            self->outQueue.push_back(std::move(data));
+            self->flush();
+        });
+    }
+
+    /**
+     * @brief Queues a response without joining head and body. Safe to call
+     * from any thread.
+     */
+    void send(HttpResponse response) {
+        queuedBytes += response.head.size() + response.body.size();
+        auto self = shared_from_this();
+        loop.post([self, response = std::move(response)]() mutable {
+            if (self->fd == INVALID_SOCKET) return;
+            self->outQueue.push_back(std::move(response.head));
+            if (!response.body.empty()) self->outQueue.push_back(std::move(response.body));
+            self->flush();
+        });
+    }
+
+    /**
+     * @brief Marks the current request as answered. The connection then
+     * either serves the next pipelined request or, if the client did not
+     * ask for keep-alive, closes after flushing. Safe from any thread.
+     */
+    void finishRequest() {
+        auto self = shared_from_this();
+        loop.post([self] {
+            if (self->fd == INVALID_SOCKET) return;
+            self->busy = false;
+            self->lastActivity = Clock::now();
+            if (self->bodyStream) {
+                // The handler answered before the upload ended; the rest of
+                // the body cannot be skipped reliably, so drop the connection
+                self->bodyStream->abort();
+                self->bodyStream.reset();
+                self->keepAlive = false;
+            }
+            if (!self->keepAlive) {
+                self->closeAfterFlush = true;
+                self->flush();
+                return;
+            }
+            if (self->readPaused) {
+                self->resumeReading();
+            } else {
+                self->processInput();
+            }
+        });
+    }
+
+    /**
+     * @brief Sends the switching-protocols response and hands all further
+     * input to `handler` instead of the HTTP parser. The request that asked
+     * for the upgrade must still be finished with finishRequest(). Safe to
+     * call from any thread.
+     */
+    void upgrade(std::string response, std::shared_ptr<ProtocolHandler> handler) {
+        queuedBytes += response.size();
+        auto self = shared_from_this();
+        loop.post([self, response = std::move(response), handler = std::move(handler)]() mutable {
+            if (self->fd == INVALID_SOCKET) {
+                handler->onClosed();
+                return;
+            }
+            self->outQueue.push_back(std::move(response));
+            self->protocol = std::move(handler);
+            self->flush();
+        });
+    }
+
+    /**
+     * @brief Closes the connection once all queued output has been written.
+     * Safe to call from any thread.
+     */
+    void close() {
+        auto self = shared_from_this();
+        loop.post([self] {
+            self->closeAfterFlush = true;
+            self->flush();
+        });
+    }
+
+    bool isOpen() const {
+        return open;
+    }
+
+    /**
+     * @brief Bytes passed to send() that are not written yet
+     */
+    size_t pendingBytes() const {
+        return queuedBytes;
+    }
+
+    /**
+     * @brief Blocks the calling worker until at most `limit` bytes are still
+     * waiting to be written. Returns false if the connection closed, so a
+     * producer streaming a large response can stop early.
+     */
+    bool waitForDrain(size_t limit) {
+        if (queuedBytes <= limit) return open;
+        std::unique_lock<std::mutex> lock(drainMutex);
+        drainWaiters++;
+        drained.wait(lock, [&] { return queuedBytes <= limit || !open; });
+        drainWaiters--;
+        return open;
+    }
+
+    /**
+     * @brief Registers the socket with its loop. Called on the loop thread.
+     */
+    void start() {
+        context.connections.insert(this);
+        if (!loop.watch(fd, shared_from_this())) {
+            closeNow();
+            return;
+        }
+        handleReadable();
+    }
+
+    /**
+     * @brief True if nothing is in flight and the client has been silent for
+     * longer than the timeout (covers both idle keep-alive connections and
+     * clients that never finish sending a request). Loop thread only.
+     */
+    bool idleSince(Clock::time_point deadline) const {
+        // Upgraded connections are long-lived by design and manage their own liveness
+        return !busy && !protocol && outQueue.empty() && lastActivity < deadline;
+    }
+
+    void onEvents(uint32_t events) override {
+        if (events & EventLoop::Readable) handleReadable();
+        if (fd != INVALID_SOCKET && (events & EventLoop::Writable)) flush();
+        if (fd != INVALID_SOCKET && (events & EventLoop::Closed)) closeNow();
+    }
+
+    void closeNow() {
+        if (fd == INVALID_SOCKET) return;
+        open = false;
+        if (bodyStream) {
+            bodyStream->abort();
+            bodyStream.reset();
+        }
+        context.connections.erase(this);
+        loop.unwatch(fd);
+        closesocket(fd);
+        fd = INVALID_SOCKET;
+        outQueue.clear();
+        notifyDrained();
+        if (protocol) {
+            auto handler = std::move(protocol);
+            handler->onClosed();
+        }
+    }
+
+private:
+    void handleReadable() {
+        char chunk[16384];
+        while (fd != INVALID_SOCKET && !readPaused) {
+            int received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received > 0) {
+                inBuffer.append(chunk, received);
+                lastActivity = Clock::now();
+                processInput();
+                continue;
+            }
+            if (received < 0 && socketInterrupted()) continue;
+            if (received < 0 && socketWouldBlock()) break;
+            closeNow();  // orderly shutdown by the peer, or a hard error
+            return;
+        }
+    }
+
+    /**
+     * @brief Feeds buffered input to the body stream in progress, then parses
+     * the next request head once no other request is in flight.
+     */
+    void processInput() {
+        while (fd != INVALID_SOCKET) {
+            if (protocol) {
+                protocol->onInput(inBuffer);
+                if (inBuffer.size() > kMaxHeaderBytes) closeNow();  // handler is not keeping up
+                return;
+            }
+            if (bodyStream) {
+                if (!feedBodyStream()) return;
+                continue;
+            }
+            if (busy || closeAfterFlush) {
+                if (inBuffer.size() > kMaxHeaderBytes + kStreamBodyThreshold) {
+                    pauseReading();  // client is pipelining far ahead of us
+                }
+                return;
+            }
+            if (!parseNextRequest()) return;
+        }
+    }
+
+    /**
+     * @brief Parses one request head from the buffer and dispatches it.
+     * Returns false if more input is needed or the request was rejected.
+     */
+    bool parseNextRequest() {
+        size_t headerEnd = inBuffer.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (inBuffer.size() > kMaxHeaderBytes) {
+                reject("431 Request Header Fields Too Large");
+            }
+            return false;
+        }
+
+        HttpRequest request;
+        request.head = inBuffer.substr(0, headerEnd + 2);
+        if (!request.parseRequestLine()) {
+            reject("400 Bad Request");
+            return false;
+        }
+
+        bool chunked = isChunkedBody(request.head);
+        // Both framings at once is how requests get smuggled; refuse it
+        if (chunked && hasContentLength(request.head)) {
+            reject("400 Bad Request");
+            return false;
+        }
+        long long contentLength = chunked ? 0 : parseContentLength(request.head);
+        if (contentLength < 0) {
+            reject("400 Bad Request");
+            return false;
+        }
+        if ((unsigned long long)contentLength > kMaxBodyBytes) {
+            reject("413 Payload Too Large");
+            return false;
+        }
+
+        if (!chunked && (size_t)contentLength <= kStreamBodyThreshold) {
+            size_t total = headerEnd + 4 + (size_t)contentLength;
+            if (inBuffer.size() < total) {
+                // The client may be holding the body back until told to go on
+                sendContinue(request);
+                return false;
+            }
+            request.body = inBuffer.substr(headerEnd + 4, (size_t)contentLength);
+            inBuffer.erase(0, total);
+        } else {
+            inBuffer.erase(0, headerEnd + 4);
+            if (chunked) {
+                bodyDecoder.startChunked();
+            } else {
+                bodyDecoder.startLength((unsigned long long)contentLength);
+            }
+            bodyStream = std::make_shared<BodyStream>();
+            std::weak_ptr<Connection> weak = shared_from_this();
+            bodyStream->setResumeCallback([weak] {
+                if (auto self = weak.lock()) {
+                    self->loop.post([self] { self->resumeReading(); });
+                }
+            });
+            request.bodyStream = bodyStream;
+            sendContinue(request);
+        }
+
+        continueSent = false;
+        busy = true;
+        keepAlive = request.keepAlive = wantsKeepAlive(request.head);
+        (*context.onRequest)(shared_from_this(), std::move(request));
+        return true;
+    }
+
+    /**
+     * @brief Answers "Expect: 100-continue" once per request, for a body
+     * that has not fully arrived yet
+     */
+    void sendContinue(const HttpRequest& request) {
+        if (continueSent || request.header("expect").find("100-continue") == std::string::npos) return;
+        continueSent = true;
+        queueOutput("HTTP/1.1 100 Continue\r\n\r\n");
+        flush();
+    }
+
+    /**
+     * @brief Decodes buffered body bytes into the stream. Returns true once
+     * the body is complete, false if more input is needed or reading paused.
+     */
+    bool feedBodyStream() {
+        while (!inBuffer.empty() && !bodyDecoder.done()) {
+            std::string piece;
+            size_t used = bodyDecoder.decode(inBuffer.data(), inBuffer.size(), piece, 64 * 1024);
+            inBuffer.erase(0, used);
+            if (bodyDecoder.failed()) {
+                closeNow();
+                return false;
+            }
+            if (!piece.empty() && !bodyStream->push(std::move(piece)) && !bodyDecoder.done()) {
+                pauseReading();
+                return false;
+            }
+        }
+        if (!bodyDecoder.done()) return false;
+
+        bodyStream->finish();
+        bodyStream.reset();
+        return true;
+    }
+
+    void pauseReading() {
+        readPaused = true;
+        loop.setReadInterest(fd, false);
+    }
+
+    void resumeReading() {
+        if (fd == INVALID_SOCKET || !readPaused) return;
+        readPaused = false;
+        loop.setReadInterest(fd, true);
+        processInput();
+        // Edge-triggered: data that arrived while paused raised no new event
+        handleReadable();
+    }
+
+    void reject(const std::string& status) {
+        busy = true;
+        inBuffer.clear();
+        queueOutput("HTTP/1.1 " + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        closeAfterFlush = true;
+        flush();
+    }
+
+    /**
+     * @brief Queues output produced on the loop thread itself
+     */
+    void queueOutput(std::string data) {
+        queuedBytes += data.size();
+        outQueue.push_back(std::move(data));
+    }
+
+    void notifyDrained() {
+        if (drainWaiters == 0) return;
+        std::lock_guard<std::mutex> lock(drainMutex);
+        drained.notify_all();
+    }
+
+    /**
+     * @brief Writes queued buffers with vectored sends until the socket
+     * would block or the queue is empty.
+     */
+    void flush() {
+        GatherBuffer buffers[kMaxGatherBuffers];
+        while (fd != INVALID_SOCKET && !outQueue.empty()) {
+            size_t count = 0;
+            for (auto it = outQueue.begin(); it != outQueue.end() && count < kMaxGatherBuffers; ++it) {
+                size_t skip = count == 0 ? outOffset : 0;
+                buffers[count++] = GatherBuffer{it->data() + skip, it->size() - skip};
+            }
+
+            long long sent = sendGather(fd, buffers, count);
+            if (sent < 0) {
+                if (socketInterrupted()) continue;
+                if (socketWouldBlock()) {
+                    loop.setWriteInterest(fd, true);
+                    return;
+                }
+                closeNow();
+                return;
+            }
+            lastActivity = Clock::now();
+            queuedBytes -= (size_t)sent;
+            notifyDrained();
+
+            size_t remaining = (size_t)sent;
+            while (!outQueue.empty() && remaining > 0) {
+                size_t left = outQueue.front().size() - outOffset;
+                if (remaining < left) {
+                    outOffset += remaining;
+                    break;
+                }
+                remaining -= left;
+                outQueue.pop_front();
+                outOffset = 0;
+            }
+        }
+        if (fd == INVALID_SOCKET) return;
+        loop.setWriteInterest(fd, false);
+        if (closeAfterFlush) closeNow();
+    }
+
+    ConnectionContext& context;
+    EventLoop& loop;
+    SOCKET fd;
+    std::string inBuffer;
+    std::deque<std::string> outQueue;
+    size_t outOffset = 0;
+    Clock::time_point lastActivity;
+    BodyDecoder bodyDecoder;
+    std::shared_ptr<BodyStream> bodyStream;  // set while a body is streaming in
+    std::shared_ptr<ProtocolHandler> protocol;  // set after a protocol upgrade
+    bool busy = false;
+    bool keepAlive = false;
+    bool continueSent = false;  // for the request whose body is awaited
+    bool readPaused = false;
+    bool closeAfterFlush = false;
+    std::atomic<bool> open{true};
+    std::atomic<size_t> queuedBytes{0};  // queued by send() but not yet written
+    std::atomic<int> drainWaiters{0};
+    std::mutex drainMutex;
+    std::condition_variable drained;
+};
+
+/**
+ * @brief Accepts connections on loop 0 and spreads them round-robin over
+ * the I/O loops. Complete requests are passed to the RequestCallback, which
+ * is expected to move the work off the I/O thread and call
+ * Connection::finishRequest() when the response has been sent.
+ */
+class HttpServer {
+public:
+    HttpServer(size_t ioThreads, RequestCallback onRequest)
+        : onRequest(std::move(onRequest)) {
+        if (ioThreads == 0) ioThreads = 1;
+        for (size_t i = 0; i < ioThreads; i++) {
+            contexts.emplace_back(new ConnectionContext());
+            contexts.back()->onRequest = &this->onRequest;
+        }
+    }
+
+    ~HttpServer() {
+        stop();
+        if (listenSocket != INVALID_SOCKET) closesocket(listenSocket);
+    }
+
+    /**
+     * @brief Closes keep-alive connections that stay idle this long
+     */
+    void setIdleTimeout(int seconds) {
+        idleTimeout = std::chrono::seconds(seconds > 0 ? seconds : 1);
+    }
+
+    /**
+     * @brief Binds and listens on the port. Returns false if the port is taken.
+     */
+    bool listen(unsigned short port) {
+        listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenSocket == INVALID_SOCKET) return false;
+        setReuseAddress(listenSocket);
+
+        sockaddr_in serverAddr{};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = INADDR_ANY;
+        serverAddr.sin_port = htons(port);
+
+        if (bind(listenSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) return false;
+        if (::listen(listenSocket, SOMAXCONN) == SOCKET_ERROR) return false;
+        return setNonBlocking(listenSocket);
+    }
+
+    /**
+     * @brief Runs the I/O loops; blocks until stop() is called.
+     */
+    void run() {
+        auto acceptor = std::make_shared<Acceptor>(*this);
+        for (auto& context : contexts) {
+            ConnectionContext* ctx = context.get();
+            bool accepts = ctx == contexts[0].get();
+            ctx->loop.setTicker(1000, [this, ctx, accepts, acceptor] {
+                closeIdleConnections(*ctx);
+                // The listener is edge-triggered: connections left waiting
+                // after a failed accept() raise no new event
+                if (accepts) acceptor->retry();
+            });
+        }
+
+        EventLoop& first = contexts[0]->loop;
+        first.post([this, acceptor, &first] {
+            first.watch(listenSocket, acceptor);
+            acceptor->onEvents(EventLoop::Readable);
+        });
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < contexts.size(); i++) {
+            threads.emplace_back([this, i] { contexts[i]->loop.run(); });
+        }
+        first.run();
+        for (auto& t : threads) t.join();
+    }
+
+    void stop() {
+        for (auto& context : contexts) context->loop.stop();
+    }
+
+    size_t ioThreadCount() const {
+        return contexts.size();
+    }
+
+    int idleTimeoutSeconds() const {
+        return (int)idleTimeout.count();
+    }
+
+private:
+    class Acceptor : public IoWatcher {
+    public:
+        explicit Acceptor(HttpServer& server) : server(server) {
+            reserveDescriptor();
+        }
+
+        ~Acceptor() override {
+#ifndef _WIN32
+            if (reserve >= 0) ::close(reserve);
+#endif
+        }
+
+        void onEvents(uint32_t) override {
+            pending = false;
+            while (true) {
+                SOCKET client = accept(server.listenSocket, nullptr, nullptr);
+                if (client == INVALID_SOCKET) {
+                    if (socketInterrupted()) continue;
+                    if (socketWouldBlock()) return;  // the end of this edge
+                    if (socketOutOfDescriptors() && shedConnection()) continue;
+                    // Connections may still be queued; the ticker comes back for them
+                    pending = true;
+                    return;
+                }
+                setNonBlocking(client);
+                setNoDelay(client);
+
+                ConnectionContext& context = *server.contexts[server.nextLoop++ % server.contexts.size()];
+                auto connection = std::make_shared<Connection>(context, client);
+                context.loop.post([connection] { connection->start(); });
+            }
+        }
+
+        /**
+         * @brief Accepts what an earlier failure left waiting, if anything
+         */
+        void retry() {
+            if (pending) onEvents(EventLoop::Readable);
+        }
+
+    private:
+        /**
+         * @brief Keeps a descriptor in hand for shedConnection()
+         */
+        void reserveDescriptor() {
+#ifndef _WIN32
+            reserve = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+#endif
+        }
+
+        /**
+         * @brief Out of descriptors: frees the reserve to accept the oldest
+         * waiting connection and close it at once, so the client gets an
+         * answer instead of a hung connect. False if there is no reserve.
+         */
+        bool shedConnection() {
+#ifdef _WIN32
+            return false;
+#else
+            if (reserve < 0) return false;
+            ::close(reserve);
+            SOCKET client = accept(server.listenSocket, nullptr, nullptr);
+            if (client != INVALID_SOCKET) closesocket(client);
+            reserveDescriptor();
+            return client != INVALID_SOCKET;
+#endif
+        }
+
+        HttpServer& server;
+#ifndef _WIN32
+        int reserve = -1;  // /dev/null, given up to shed a connection
+#endif
+        bool pending = false;  // a failed accept() may have left connections queued
+    };
+
+    void closeIdleConnections(ConnectionContext& context) {
+        auto deadline = Connection::Clock::now() - idleTimeout;
+        std::vector<std::shared_ptr<Connection>> idle;
+        for (Connection* connection : context.connections) {
+            if (connection->idleSince(deadline)) idle.push_back(connection->shared_from_this());
+        }
+        for (auto& connection : idle) {
+            connection->closeNow();
+        }
+    }
+
+    std::vector<std::unique_ptr<ConnectionContext>> contexts;
+    RequestCallback onRequest;
+    SOCKET listenSocket = INVALID_SOCKET;
+    size_t nextLoop = 0;
+    std::chrono::seconds idleTimeout{15};
+};
+
+#endif // DECLUTTER_HTTP_SERVER_HPP
@@ -0,0 +1,207 @@
+#ifndef DECLUTTER_JOB_SCHEDULER_HPP
+#define DECLUTTER_JOB_SCHEDULER_HPP
+
+#include "cancellation.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+// ============================================================================
+// Background Jobs (submit / poll / result)
+// ============================================================================
+
+enum class JobState { Queued, Scanning, Deleting, Finished };
+
+inline const char* jobStateName(JobState state) {
+    switch (state) {
+        case JobState::Queued: return "queued";
+        case JobState::Scanning: return "scanning";
+        case JobState::Deleting: return "deleting";
+        default: return "finished";
+    }
+}
+
+/**
+ * @brief Live counters of a job. Only the job's worker writes them (relaxed
+ * increments), status queries read them without taking any lock.
+ */
+struct JobCounters {
+    std::atomic<long long> filesScanned{0};
+    std::atomic<long long> filesMatched{0};
+    std::atomic<unsigned long long> bytesMatched{0};
+    std::atomic<long long> filesDeleted{0};
+    std::atomic<long long> filesFailed{0};
+    std::atomic<long long> filesSkipped{0};  // changed since the scan, kept
+    std::atomic<unsigned long long> bytesFreed{0};
+};
+
+/**
+ * @brief One submitted job. The result is written once by the worker and
+ * published by the release store of the Finished state.
+ */
+class Job {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Job(std::string id) : id(std::move(id)), submitted(Clock::now()) {}
+
+    void setState(JobState next) {
+        state.store(next, std::memory_order_release);
+    }
+
+    JobState currentState() const {
+        return state.load(std::memory_order_acquire);
+    }
+
+    void finish(std::string resultJson) {
+        resultBody = std::move(resultJson);
+        elapsedAtFinish.store(elapsedMs(), std::memory_order_relaxed);
+        setState(JobState::Finished);
+    }
+
+    bool finished() const {
+        return currentState() == JobState::Finished;
+    }
+
+    /**
+     * @brief The result document; only valid once finished() is true
+     */
+    const std::string& result() const {
+        return resultBody;
+    }
+
+    long long elapsedMs() const {
+        long long frozen = elapsedAtFinish.load(std::memory_order_relaxed);
+        if (frozen >= 0) return frozen;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - submitted).count();
+    }
+
+    const std::string id;
+    JobCounters counters;
+    CancellationToken cancellation;
+
+private:
+    Clock::time_point submitted;
+    std::atomic<JobState> state{JobState::Queued};
+    std::atomic<long long> elapsedAtFinish{-1};
+    std::string resultBody;
+};
+
+/**
+ * @brief Runs jobs on a dedicated bounded pool and keeps them addressable by
+ * id until they have been finished for a while. At most maxConcurrent jobs
+ * run at once and maxQueued wait; further submissions are refused.
+ */
+class JobScheduler {
+public:
+    // Finished jobs beyond this many are forgotten, oldest first
+    static constexpr size_t kMaxRetainedJobs = 256;
+
+    JobScheduler(size_t maxConcurrent, size_t maxQueued)
+        : random(std::random_device{}()), pool(maxConcurrent, maxQueued) {}
+
+    ~JobScheduler() {
+        shutdown();
+    }
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    /**
+     * @brief Queues a job. Returns null if the scheduler is at its limit.
+     */
+    std::shared_ptr<Job> submit(std::function<void(Job&)> work) {
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = std::make_shared<Job>(newId());
+            jobs[job->id] = job;
+        }
+
+        bool queued = pool.submit([this, job, work = std::move(work)] {
+            try {
+                if (job->cancellation.stopRequested()) {
+                    job->finish("{\"success\":false,\"message\":\"Job cancelled before it started\",\"count\":0,"
+                                "\"truncated\":true,\"cancelReason\":\"" +
+                                std::string(cancelReasonName(job->cancellation.reason())) + "\"}");
+                } else {
+                    work(*job);
+                }
+            } catch (...) {
+                if (!job->finished()) job->finish("{\"success\":false,\"message\":\"Job failed\"}");
+            }
+            retire(job->id);
+        });
+        if (!queued) {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.erase(job->id);
+            return nullptr;
+        }
+        return job;
+    }
+
+    std::shared_ptr<Job> find(const std::string& id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        return it == jobs.end() ? nullptr : it->second;
+    }
+
+    /**
+     * @brief Asks a job to stop. A queued job finishes without running; a
+     * running one stops at its next check. Returns false for unknown ids.
+     */
+    bool cancel(const std::string& id) {
+        auto job = find(id);
+        if (!job || job->finished()) return false;
+        job->cancellation.cancel();
+        return true;
+    }
+
+    /**
+     * @brief Lets running jobs finish, then joins the job threads
+     */
+    void shutdown() {
+        pool.shutdown();
+    }
+
+    size_t concurrency() const {
+        return pool.size();
+    }
+
+    size_t queueLimit() const {
+        return pool.queueLimit();
+    }
+
+private:
+    std::string newId() {
+        char id[17];
+        snprintf(id, sizeof(id), "%016llx", (unsigned long long)random());
+        return id;
+    }
+
+    void retire(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishedOrder.push_back(id);
+        while (finishedOrder.size() > kMaxRetainedJobs) {
+            jobs.erase(finishedOrder.front());
+            finishedOrder.pop_front();
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Job>> jobs;
+    std::deque<std::string> finishedOrder;
+    std::mt19937_64 random;
+    ThreadPool pool;  // last, so its threads stop before the state above goes away
+};
+
+#endif // DECLUTTER_JOB_SCHEDULER_HPP
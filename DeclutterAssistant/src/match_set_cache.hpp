@@ -0,0 +1,130 @@
+#ifndef DECLUTTER_MATCH_SET_CACHE_HPP
+#define DECLUTTER_MATCH_SET_CACHE_HPP
+
+#include "file_table.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Scan Tokens (previewed match sets, handed from /scan-cleanup to /cleanup)
+// ============================================================================
+//
+// A completed preview scan stores its matches here and returns a token.
+// The cleanup that follows takes the set back by token and deletes exactly
+// those files, after checking each one is unchanged, instead of walking
+// the tree a second time. Clients that shared one scan each store the same
+// set under a token of their own; it is held, and counted, once.
+
+// Files held across all cached sets; the oldest sets are dropped beyond it,
+// and a single set larger than this is not cached at all
+constexpr size_t kMatchSetCacheMaxEntries = 1000000;
+
+// A preview older than this is stale; the user has to scan again
+constexpr std::chrono::minutes kMatchSetLifetime(15);
+
+/**
+ * @brief The matches of one preview scan. Never modified once stored.
+ */
+struct MatchSet {
+    std::string root;  // normalized scan directory
+    FileTable matches;  // with the size and time each had when it matched
+    uintmax_t totalSize = 0;
+};
+
+class MatchSetCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    MatchSetCache() : random(std::random_device{}()) {}
+
+    /**
+     * @brief Caches a set and returns a new token for it, or an empty string
+     * if the set is too large to keep. A set may be stored more than once.
+     */
+    std::string store(std::shared_ptr<const MatchSet> set) {
+        size_t size = set->matches.size();
+        if (size > kMatchSetCacheMaxEntries) return "";
+
+        std::lock_guard<std::mutex> lock(mutex);
+        expire(Clock::now());
+        if (tokensOf.count(set.get()) == 0) {
+            while (entries + size > kMatchSetCacheMaxEntries && !order.empty()) drop(order.front());
+            entries += size;
+        }
+        tokensOf[set.get()]++;
+
+        char token[33];
+        snprintf(token, sizeof(token), "%016llx%016llx", (unsigned long long)random(), (unsigned long long)random());
+        sets[token] = Entry{std::move(set), Clock::now() + kMatchSetLifetime};
+        order.push_back(token);
+        return token;
+    }
+
+    /**
+     * @brief Removes and returns the set for a token; null if the token is
+     * unknown, already used or expired
+     */
+    std::shared_ptr<const MatchSet> take(const std::string& token) {
+        std::lock_guard<std::mutex> lock(mutex);
+        expire(Clock::now());
+        auto it = sets.find(token);
+        if (it == sets.end()) return nullptr;
+        std::shared_ptr<const MatchSet> set = it->second.set;
+        drop(token);
+        return set;
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const MatchSet> set;
+        Clock::time_point expires;
+    };
+
+    // Sets are stored in order, and all live equally long, so the expired
+    // ones are at the front. Call with the mutex held.
+    void expire(Clock::time_point now) {
+        while (!order.empty()) {
+            auto it = sets.find(order.front());
+            if (it != sets.end() && it->second.expires > now) return;
+            drop(order.front());
+        }
+    }
+
+    // Call with the mutex held
+    void drop(std::string token) {
+        auto it = sets.find(token);
+        if (it != sets.end()) {
+            auto count = tokensOf.find(it->second.set.get());
+            if (--count->second == 0) {
+                entries -= it->second.set->matches.size();
+                tokensOf.erase(count);
+            }
+            sets.erase(it);
+        }
+        for (auto pos = order.begin(); pos != order.end(); ++pos) {
+            if (*pos == token) {
+                order.erase(pos);
+                break;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> sets;
+    std::deque<std::string> order;  // tokens, oldest first
+    std::unordered_map<const MatchSet*, size_t> tokensOf;  // live tokens per stored set
+    size_t entries = 0;  // files in the stored sets, each set counted once
+    std::mt19937_64 random;
+};
+
+#endif // DECLUTTER_MATCH_SET_CACHE_HPP
@@ -0,0 +1,335 @@
+#ifndef DECLUTTER_PARALLEL_WALKER_HPP
+#define DECLUTTER_PARALLEL_WALKER_HPP
+
+#include "cancellation.hpp"
+#include "directory_reader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Parallel Directory Traversal (work-stealing)
+// ============================================================================
+//
+// Every walking thread owns a deque of directories still to be read. It
+// pushes the subdirectories it finds onto its own deque and takes the most
+// recent one back (depth first, so its working set stays small); a thread
+// that runs dry steals the oldest directory of another thread, which tends
+// to be a large subtree. Reading directories is the slow part, so keeping
+// many in flight is what uses the device's queue depth.
+//
+// The per-entry work (the "inspect" step) runs on the walking threads. The
+// results of each directory are then handed to "deliver" one directory at
+// a time, so the consumer needs no locking of its own. A directory is
+// always delivered before any of its subdirectories.
+
+// Upper bound for walking threads; beyond it the device is the limit
+constexpr size_t kMaxWalkThreads = 16;
+
+// An idle thread retries stealing this often while others are still busy
+constexpr std::chrono::microseconds kWalkIdleBackoff(100);
+
+/**
+ * @brief The results of one directory, as passed to deliver
+ */
+template <typename Record>
+struct DirectoryBatch {
+    const std::filesystem::path& directory;
+    int depth;            // 0 for the root
+    size_t files;         // entries inspect counted
+    size_t subdirectories;  // each delivered later
+    std::vector<Record>& records;
+};
+
+template <typename Record>
+class ParallelWalker {
+public:
+    /**
+     * @brief Looks at one entry that is not a directory to descend into;
+     * runs concurrently. Appends any results to `out` and returns true if
+     * the entry counts as a file. Ask the entry only for what is needed:
+     * its name and type are free, its path and status are not.
+     */
+    using Inspect = std::function<bool(const WalkEntry& entry, std::vector<Record>& out)>;
+
+    /**
+     * @brief Receives a directory's results, one directory at a time.
+     * Returning false stops the walk.
+     */
+    using Deliver = std::function<bool(const DirectoryBatch<Record>& batch)>;
+
+    struct Options {
+        size_t threads = 1;
+        // Deliver directories in pre-order with entries sorted by name, so
+        // the same tree always gives the same sequence. Costs buffering of
+        // directories finished ahead of their turn.
+        bool ordered = false;
+        CancellationToken* cancellation = nullptr;
+    };
+
+    /**
+     * @brief Walks the tree below root. Returns true if every directory was
+     * delivered, false if the walk was cancelled or deliver stopped it.
+     */
+    static bool run(const std::filesystem::path& root, const Options& options, const Inspect& inspect,
+                    const Deliver& deliver) {
+        ParallelWalker walker(options, inspect, deliver);
+        return walker.walk(root);
+    }
+
+private:
+    struct Node {
+        std::filesystem::path directory;
+        int depth = 0;
+        Node* parent = nullptr;
+        // Ordered mode only: the tree is kept until its turn to be delivered
+        std::vector<std::unique_ptr<Node>> children;
+        size_t nextChild = 0;
+        bool scanned = false;
+        bool delivered = false;
+        size_t files = 0;
+        size_t subdirectories = 0;
+        std::vector<Record> records;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Node*> nodes;
+    };
+
+    ParallelWalker(const Options& options, const Inspect& inspect, const Deliver& deliver)
+        : options(options), inspect(inspect), deliver(deliver) {
+        size_t threads = std::min(std::max<size_t>(options.threads, 1), kMaxWalkThreads);
+        for (size_t i = 0; i < threads; i++) queues.emplace_back(new WorkQueue());
+    }
+
+    bool walk(const std::filesystem::path& root) {
+        rootNode.reset(new Node());
+        rootNode->directory = root;
+        pending = 1;
+        queues[0]->nodes.push_back(rootNode.get());
+        cursor = rootNode.get();
+
+        // The calling thread is walker 0; helpers that fail to start just
+        // leave more for the others
+        std::vector<std::thread> helpers;
+        for (size_t i = 1; i < queues.size(); i++) {
+            try {
+                helpers.emplace_back([this, i] { work(i); });
+            } catch (const std::system_error&) {
+                break;
+            }
+        }
+        work(0);
+        for (auto& helper : helpers) helper.join();
+
+        // Unordered nodes are owned by whoever holds them; free the ones a
+        // stopped walk left behind
+        if (!options.ordered) {
+            for (auto& queue : queues) {
+                for (Node* node : queue->nodes) {
+                    if (node != rootNode.get()) delete node;
+                }
+            }
+        }
+        return !stopping;
+    }
+
+    void work(size_t self) {
+        DirectoryReader reader;
+        unsigned idleRounds = 0;
+        while (!stopping) {
+            Node* node = take(self);
+            if (!node) {
+                if (pending.load(std::memory_order_acquire) == 0) return;
+                if (++idleRounds < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(kWalkIdleBackoff);
+                }
+                continue;
+            }
+            idleRounds = 0;
+
+            if (options.cancellation && options.cancellation->stopRequested()) {
+                stopping = true;
+                release(node);
+                return;
+            }
+            std::vector<std::unique_ptr<Node>> subdirectories;
+            scan(reader, node, subdirectories);
+            // Queued subdirectories could be read and delivered by another
+            // thread before their parent; the ordered cursor needs them in
+            // place before it gets there
+            if (options.ordered) enqueue(self, node, subdirectories);
+            finish(node);
+            if (!options.ordered) enqueue(self, node, subdirectories);
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    /**
+     * @brief Own deque from the back, else steal from the front of another
+     */
+    Node* take(size_t self) {
+        {
+            WorkQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.nodes.empty()) {
+                Node* node = own.nodes.back();
+                own.nodes.pop_back();
+                return node;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            WorkQueue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.nodes.empty()) {
+                Node* node = victim.nodes.front();
+                victim.nodes.pop_front();
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    void scan(DirectoryReader& reader, Node* node, std::vector<std::unique_ptr<Node>>& subdirectories) {
+        std::vector<SavedEntry> entries;
+
+        // Unreadable directories (e.g. permission denied) are just empty
+        reader.open(node->directory, node->depth == 0);
+        WalkEntry entry;
+        size_t entriesSinceCheck = 0;
+        while (reader.next(entry)) {
+            // A single directory can be huge; don't wait for its end to stop
+            if (++entriesSinceCheck == kCancellationCheckInterval) {
+                entriesSinceCheck = 0;
+                if (stopping || (options.cancellation && options.cancellation->stopRequested())) {
+                    stopping = true;
+                    break;
+                }
+            }
+            // Like recursive_directory_iterator: descend into real
+            // directories, never through symlinks
+            if (entry.type() == WalkEntry::Type::Directory) {
+                std::unique_ptr<Node> child(new Node());
+                child->directory = entry.path();
+                child->depth = node->depth + 1;
+                child->parent = node;
+                subdirectories.push_back(std::move(child));
+            } else if (options.ordered) {
+                entries.push_back(entry.save());
+            } else {
+                inspectEntry(entry, node);
+            }
+        }
+
+        if (options.ordered) {
+            std::sort(entries.begin(), entries.end(),
+                      [](const SavedEntry& a, const SavedEntry& b) { return a.name < b.name; });
+            for (const auto& saved : entries) {
+                reader.restore(saved, entry);
+                inspectEntry(entry, node);
+            }
+            std::sort(subdirectories.begin(), subdirectories.end(),
+                      [](const std::unique_ptr<Node>& a, const std::unique_ptr<Node>& b) {
+                          return a->directory.filename() < b->directory.filename();
+                      });
+        }
+
+        node->subdirectories = subdirectories.size();
+    }
+
+    /**
+     * @brief Queues a read directory's subdirectories on the thread's own
+     * deque. In unordered mode the directory itself may already be gone.
+     */
+    void enqueue(size_t self, Node* node, std::vector<std::unique_ptr<Node>>& subdirectories) {
+        if (subdirectories.empty()) return;
+        pending.fetch_add(subdirectories.size(), std::memory_order_acq_rel);
+        WorkQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        // Reversed, so the first subdirectory is taken back first
+        for (auto child = subdirectories.rbegin(); child != subdirectories.rend(); ++child) {
+            own.nodes.push_back(options.ordered ? child->get() : child->release());
+        }
+        if (options.ordered) node->children = std::move(subdirectories);
+    }
+
+    void inspectEntry(const WalkEntry& entry, Node* node) {
+        try {
+            if (inspect(entry, node->records)) node->files++;
+        } catch (...) {
+            // One unreadable file must not end the walk
+        }
+    }
+
+    /**
+     * @brief Hands a scanned directory over; in ordered mode that also
+     * delivers whatever has become next in line
+     */
+    void finish(Node* node) {
+        std::lock_guard<std::mutex> lock(deliverMutex);
+        node->scanned = true;
+        if (!options.ordered) {
+            deliverNode(node);
+            release(node);
+            return;
+        }
+
+        // Pre-order: a directory, then each of its subdirectories' trees
+        while (cursor && cursor->scanned && !stopping) {
+            if (!cursor->delivered) {
+                deliverNode(cursor);
+                cursor->delivered = true;
+            }
+            if (cursor->nextChild < cursor->children.size()) {
+                cursor = cursor->children[cursor->nextChild++].get();
+                continue;
+            }
+            // Subtree done; free it and move back up
+            Node* done = cursor;
+            cursor = done->parent;
+            done->children.clear();
+        }
+    }
+
+    // Call with deliverMutex held
+    void deliverNode(Node* node) {
+        if (stopping) return;
+        try {
+            DirectoryBatch<Record> batch{node->directory, node->depth, node->files, node->subdirectories, node->records};
+            if (!deliver(batch)) stopping = true;
+        } catch (...) {
+            stopping = true;
+        }
+        std::vector<Record>().swap(node->records);
+    }
+
+    // Unordered nodes other than the root belong to whoever took them
+    void release(Node* node) {
+        if (!options.ordered && node != rootNode.get()) delete node;
+    }
+
+    const Options& options;
+    const Inspect& inspect;
+    const Deliver& deliver;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::unique_ptr<Node> rootNode;  // in unordered mode, owns only the root itself
+    std::atomic<size_t> pending{0};  // directories queued or being read
+    std::atomic<bool> stopping{false};
+    std::mutex deliverMutex;
+    Node* cursor = nullptr;  // ordered mode: next directory to deliver
+};
+
+#endif // DECLUTTER_PARALLEL_WALKER_HPP
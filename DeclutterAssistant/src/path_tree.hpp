@@ -0,0 +1,176 @@
+#ifndef DECLUTTER_PATH_TREE_HPP
+#define DECLUTTER_PATH_TREE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Path Trees (directories stored once per name, not once per path)
+// ============================================================================
+//
+// A large scan sees the same deep prefix in every path below it. A path
+// tree keeps each directory as a node pointing to its parent, with only its
+// own name, so every prefix is stored once however many paths share it.
+// Names go into a bump arena: blocks that are filled front to back and
+// freed all together, with no per-name heap allocation. A full path is put
+// together from the nodes only when someone asks for it.
+//
+// A path is split at its separators; the first part keeps any separators
+// it starts with, so "/usr/lib" is "/usr" and "lib", "C:\Users" is "C:" and
+// "Users", and joining the parts gives the path back.
+
+// Names are carved out of blocks of this size; a longer name gets a block
+// of its own
+constexpr size_t kPathArenaBlock = 64 * 1024;
+
+/**
+ * @brief Stores strings back to back in large blocks. Stored strings stay
+ * where they are until the arena is cleared.
+ */
+class NameArena {
+public:
+    std::string_view store(std::string_view text) {
+        if (text.size() > kPathArenaBlock) {
+            big.emplace_back(new char[text.size()]);
+            std::memcpy(big.back().get(), text.data(), text.size());
+            return std::string_view(big.back().get(), text.size());
+        }
+        if (blocks.empty() || kPathArenaBlock - used < text.size()) {
+            blocks.emplace_back(new char[kPathArenaBlock]);
+            used = 0;
+        }
+        char* start = blocks.back().get() + used;
+        std::memcpy(start, text.data(), text.size());
+        used += text.size();
+        return std::string_view(start, text.size());
+    }
+
+    void clear() {
+        blocks.clear();
+        big.clear();
+        used = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::unique_ptr<char[]>> big;  // names larger than a block
+    size_t used = 0;                           // bytes taken in the last block
+};
+
+class PathTree {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    /**
+     * @brief The node of a directory path, added along with any missing
+     * ancestors
+     */
+    uint32_t intern(std::string_view path) {
+        uint32_t node = kNone;
+        size_t start = 0;
+        // The separators a path starts with belong to its first part
+        while (start < path.size() && isSeparator(path[start])) start++;
+        size_t first = 0;
+        while (start <= path.size()) {
+            size_t end = start;
+            while (end < path.size() && !isSeparator(path[end])) end++;
+            if (end > start || node == kNone) node = child(node, path.substr(first, end - first));
+            start = end + 1;
+            first = start;
+        }
+        return node;
+    }
+
+    /**
+     * @brief The node named `name` below `parent` (kNone for a top part),
+     * added if it is new
+     */
+    uint32_t child(uint32_t parent, std::string_view name) {
+        auto it = children.find(Key{parent, name});
+        if (it != children.end()) return it->second;
+        std::string_view stored = arena.store(name);
+        nodes.push_back(Node{parent, stored});
+        uint32_t node = (uint32_t)(nodes.size() - 1);
+        children.emplace(Key{parent, stored}, node);
+        return node;
+    }
+
+    uint32_t parent(uint32_t node) const {
+        return nodes[node].parent;
+    }
+
+    std::string_view name(uint32_t node) const {
+        return nodes[node].name;
+    }
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+    void appendPath(uint32_t node, std::string& out) const {
+        const Node& entry = nodes[node];
+        if (entry.parent != kNone) {
+            appendPath(entry.parent, out);
+            if (!out.empty() && !isSeparator(out.back())) out += (char)std::filesystem::path::preferred_separator;
+        }
+        out += entry.name;
+    }
+
+    std::string path(uint32_t node) const {
+        std::string out;
+        appendPath(node, out);
+        return out;
+    }
+
+    void clear() {
+        nodes.clear();
+        children.clear();
+        arena.clear();
+    }
+
+    /**
+     * @brief Drops the lookup of existing children, for a tree that gets no
+     * more paths. Paths interned afterwards no longer share the old nodes.
+     */
+    void freeze() {
+        nodes.shrink_to_fit();
+        std::unordered_map<Key, uint32_t, KeyHash>().swap(children);
+    }
+
+private:
+    struct Node {
+        uint32_t parent;
+        std::string_view name;  // in the arena
+    };
+
+    struct Key {
+        uint32_t parent;
+        std::string_view name;
+
+        bool operator==(const Key& other) const {
+            return parent == other.parent && name == other.name;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<std::string_view>()(key.name) * 31 + key.parent;
+        }
+    };
+
+    static bool isSeparator(char c) {
+        return c == '/' || c == (char)std::filesystem::path::preferred_separator;
+    }
+
+    std::vector<Node> nodes;
+    std::unordered_map<Key, uint32_t, KeyHash> children;
+    NameArena arena;
+};
+
+#endif // DECLUTTER_PATH_TREE_HPP
@@ -0,0 +1,196 @@
+#ifndef DECLUTTER_PLATFORM_HPP
+#define DECLUTTER_PLATFORM_HPP
+
+// ============================================================================
+// Platform Abstraction (sockets, local time)
+// ============================================================================
+//
+// The server was written against Winsock; on POSIX systems the same names
+// (SOCKET, INVALID_SOCKET, closesocket) are provided here so the request
+// handling code does not need to care which platform it runs on.
+
+#ifdef _WIN32
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600  // WSAPoll
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <shlobj.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+#else
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using SOCKET = int;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+inline int closesocket(SOCKET s) {
+    return ::close(s);
+}
+
+#endif
+
+#include <cstddef>
+#include <ctime>
+
+#ifdef _WIN32
+constexpr int kSendFlags = 0;
+#else
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+/**
+ * @brief Starts the socket layer (WSAStartup on Windows, SIGPIPE off on POSIX)
+ */
+inline bool initNetworking() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+}
+
+inline void cleanupNetworking() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+inline bool setNonBlocking(SOCKET s) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+inline void setNoDelay(SOCKET s) {
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+inline void setReuseAddress(SOCKET s) {
+#ifndef _WIN32
+    // On Windows SO_REUSEADDR allows port hijacking, so it is POSIX-only
+    int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+#else
+    (void)s;
+#endif
+}
+
+/**
+ * @brief One piece of a vectored write
+ */
+struct GatherBuffer {
+    const char* data;
+    size_t size;
+};
+
+constexpr size_t kMaxGatherBuffers = 64;
+
+/**
+ * @brief Sends several buffers with one call (sendmsg / WSASend) so headers
+ * and body leave together without being concatenated first. Returns the
+ * number of bytes sent, or -1 on error.
+ */
+inline long long sendGather(SOCKET s, const GatherBuffer* buffers, size_t count) {
+    if (count > kMaxGatherBuffers) count = kMaxGatherBuffers;
+#ifdef _WIN32
+    WSABUF wsaBuffers[kMaxGatherBuffers];
+    for (size_t i = 0; i < count; i++) {
+        wsaBuffers[i].buf = (CHAR*)buffers[i].data;
+        wsaBuffers[i].len = (ULONG)buffers[i].size;
+    }
+    DWORD sent = 0;
+    if (WSASend(s, wsaBuffers, (DWORD)count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) return -1;
+    return (long long)sent;
+#else
+    iovec iov[kMaxGatherBuffers];
+    for (size_t i = 0; i < count; i++) {
+        iov[i].iov_base = (void*)buffers[i].data;
+        iov[i].iov_len = buffers[i].size;
+    }
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    return (long long)sendmsg(s, &msg, kSendFlags);
+#endif
+}
+
+/**
+ * @brief True if the last socket call failed only because it would block
+ */
+inline bool socketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/**
+ * @brief True if the last socket call was interrupted by a signal before it
+ * did anything; it should simply be made again
+ */
+inline bool socketInterrupted() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
+/**
+ * @brief True if the last accept() failed for lack of file descriptors
+ */
+inline bool socketOutOfDescriptors() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEMFILE;
+#else
+    return errno == EMFILE || errno == ENFILE;
+#endif
+}
+
+/**
+ * @brief Portable poll(); WSAPoll on Windows
+ */
+#ifdef _WIN32
+using PollFd = WSAPOLLFD;
+inline int pollSockets(PollFd* fds, size_t count, int timeoutMs) {
+    return WSAPoll(fds, (ULONG)count, timeoutMs);
+}
+#else
+using PollFd = pollfd;
+inline int pollSockets(PollFd* fds, size_t count, int timeoutMs) {
+    return ::poll(fds, (nfds_t)count, timeoutMs);
+}
+#endif
+
+inline void toLocalTime(time_t value, struct tm& out) {
+#ifdef _WIN32
+    localtime_s(&out, &value);
+#else
+    localtime_r(&value, &out);
+#endif
+}
+
+#endif // DECLUTTER_PLATFORM_HPP
@@ -0,0 +1,115 @@
+#ifndef DECLUTTER_PROGRESS_HUB_HPP
+#define DECLUTTER_PROGRESS_HUB_HPP
+
+#include "ws_server.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Progress Fan-Out to WebSocket Subscribers
+// ============================================================================
+
+// Intermediate frames are dropped for a client that has this much unsent;
+// it gets the next one once it catches up
+constexpr size_t kProgressMaxPendingBytes = 64 * 1024;
+
+/**
+ * @brief Delivers progress messages for running jobs to the WebSocket
+ * clients that subscribed to them. Thread-safe: sessions subscribe from
+ * workers, publishers are scanning workers, and closing connections
+ * unsubscribe from the I/O threads.
+ */
+class ProgressHub {
+public:
+    /**
+     * @brief Subscribes a session to one job, or to every job if jobId is empty
+     */
+    void subscribe(const std::shared_ptr<WebSocketSession>& session, std::string jobId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscribers.push_back(Subscriber{session, std::move(jobId)});
+    }
+
+    void unsubscribe(const WebSocketSession* session) {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                         [session](const Subscriber& s) { return s.session.get() == session; }),
+                          subscribers.end());
+    }
+
+    /**
+     * @brief Also delivers the messages published for `target` to the
+     * subscribers of `jobId`, e.g. when a request shares another's scan
+     */
+    void addAlias(const std::string& jobId, const std::string& target) {
+        if (jobId.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        aliases.emplace(target, jobId);
+    }
+
+    void removeAlias(const std::string& jobId, const std::string& target) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto range = aliases.equal_range(target);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == jobId) {
+                aliases.erase(it);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Lets publishers skip building messages nobody will receive
+     */
+    bool hasSubscribers(const std::string& jobId) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& s : subscribers) {
+            if (receives(s, jobId)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Sends a message to the job's subscribers. Final messages are
+     * always queued; intermediate ones skip clients that are falling behind.
+     */
+    void publish(const std::string& jobId, const std::string& message, bool final) {
+        std::vector<std::shared_ptr<WebSocketSession>> targets;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& s : subscribers) {
+                if (receives(s, jobId)) targets.push_back(s.session);
+            }
+        }
+        for (auto& session : targets) {
+            if (!final && session->pendingBytes() > kProgressMaxPendingBytes) continue;
+            session->sendText(message);
+        }
+    }
+
+private:
+    struct Subscriber {
+        std::shared_ptr<WebSocketSession> session;
+        std::string jobId;
+    };
+
+    // Call with the mutex held
+    bool receives(const Subscriber& subscriber, const std::string& jobId) const {
+        if (subscriber.jobId.empty() || subscriber.jobId == jobId) return true;
+        auto range = aliases.equal_range(jobId);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == subscriber.jobId) return true;
+        }
+        return false;
+    }
+
+    mutable std::mutex mutex;
+    std::vector<Subscriber> subscribers;
+    std::unordered_multimap<std::string, std::string> aliases;  // target -> alias
+};
+
+#endif // DECLUTTER_PROGRESS_HUB_HPP
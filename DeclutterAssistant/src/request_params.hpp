@@ -0,0 +1,211 @@
+#ifndef DECLUTTER_REQUEST_PARAMS_HPP
+#define DECLUTTER_REQUEST_PARAMS_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// ============================================================================
+// Request Parameter Parsing (query strings, flat JSON bodies)
+// ============================================================================
+//
+// Everything here works on string_views into the request and decodes into
+// storage owned by the caller. Nothing allocates except growing that
+// storage, so a caller that reuses its strings parses without allocating.
+
+inline int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+inline void appendUtf8(unsigned cp, std::string& out) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+/**
+ * @brief Percent-decodes a query component into `out` ('+' is a space).
+ * Malformed escapes are kept as they are.
+ */
+inline void urlDecodeInto(std::string_view in, std::string& out) {
+    out.clear();
+    for (size_t i = 0; i < in.size(); i++) {
+        char c = in[i];
+        if (c == '%' && i + 2 < in.size()) {
+            int high = hexDigitValue(in[i + 1]);
+            int low = hexDigitValue(in[i + 2]);
+            if (high >= 0 && low >= 0) {
+                out += (char)(high * 16 + low);
+                i += 2;
+                continue;
+            }
+        }
+        out += c == '+' ? ' ' : c;
+    }
+}
+
+/**
+ * @brief Finds the raw (still encoded) value of a query parameter in a
+ * request target such as "/files?directory=%2Ftmp". Only whole names match.
+ */
+inline bool findQueryParam(std::string_view target, std::string_view name, std::string_view& raw) {
+    size_t query = target.find('?');
+    if (query == std::string_view::npos) return false;
+
+    size_t pos = query + 1;
+    while (pos <= target.size()) {
+        size_t end = target.find('&', pos);
+        if (end == std::string_view::npos) end = target.size();
+        std::string_view pair = target.substr(pos, end - pos);
+
+        size_t equals = pair.find('=');
+        if (pair.substr(0, equals) == name) {
+            raw = equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+/**
+ * @brief True if the parameter is present with a non-empty value
+ */
+inline bool hasQueryParam(std::string_view target, std::string_view name) {
+    std::string_view raw;
+    return findQueryParam(target, name, raw) && !raw.empty();
+}
+
+/**
+ * @brief Typed query parameters. Each returns false if the parameter is
+ * missing, empty or not of the requested type. A string value is cleared
+ * when the parameter is missing.
+ */
+inline bool queryParam(std::string_view target, std::string_view name, std::string& value) {
+    value.clear();
+    std::string_view raw;
+    if (!findQueryParam(target, name, raw) || raw.empty()) return false;
+    urlDecodeInto(raw, value);
+    return true;
+}
+
+inline bool queryParam(std::string_view target, std::string_view name, long long& value) {
+    std::string_view raw;
+    if (!findQueryParam(target, name, raw) || raw.empty()) return false;
+
+    // Numbers are rarely escaped; decode into a small stack buffer if they are
+    char decoded[32];
+    size_t length = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (length == sizeof(decoded)) return false;
+        if (raw[i] == '%' && i + 2 < raw.size()) {
+            int high = hexDigitValue(raw[i + 1]);
+            int low = hexDigitValue(raw[i + 2]);
+            if (high < 0 || low < 0) return false;
+            decoded[length++] = (char)(high * 16 + low);
+            i += 2;
+        } else {
+            decoded[length++] = raw[i];
+        }
+    }
+
+    long long parsed = 0;
+    auto result = std::from_chars(decoded, decoded + length, parsed);
+    if (result.ec != std::errc() || result.ptr != decoded + length) return false;
+    value = parsed;
+    return true;
+}
+
+inline size_t skipJSONSpace(std::string_view json, size_t pos) {
+    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n')) pos++;
+    return pos;
+}
+
+/**
+ * @brief Finds the value of "key" in a flat JSON object and returns a view
+ * starting at its first character (the opening quote for strings).
+ */
+inline bool findJSONValue(std::string_view json, std::string_view key, std::string_view& value) {
+    size_t pos = 0;
+    while ((pos = json.find(key, pos)) != std::string_view::npos) {
+        size_t keyEnd = pos + key.size();
+        bool quoted = pos > 0 && json[pos - 1] == '"' && keyEnd < json.size() && json[keyEnd] == '"';
+        pos = keyEnd;
+        if (!quoted) continue;
+
+        size_t colon = skipJSONSpace(json, keyEnd + 1);
+        if (colon >= json.size() || json[colon] != ':') continue;
+
+        value = json.substr(skipJSONSpace(json, colon + 1));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Reads a JSON string value into `out`, resolving escapes. Returns
+ * false (with `out` empty) if the key is missing or not a string.
+ */
+inline bool jsonStringValue(std::string_view json, std::string_view key, std::string& out) {
+    out.clear();
+    std::string_view value;
+    if (!findJSONValue(json, key, value) || value.empty() || value[0] != '"') return false;
+
+    for (size_t i = 1; i < value.size(); i++) {
+        char c = value[i];
+        if (c == '"') return true;
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++i == value.size()) break;  // unterminated
+        switch (value[i]) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                unsigned cp = 0;
+                for (size_t k = 1; k <= 4; k++) {
+                    int digit = i + k < value.size() ? hexDigitValue(value[i + k]) : -1;
+                    if (digit < 0) {
+                        out.clear();
+                        return false;
+                    }
+                    cp = cp * 16 + (unsigned)digit;
+                }
+                appendUtf8(cp, out);
+                i += 4;
+                break;
+            }
+            default: out += value[i]; break;  // \\ \" \/
+        }
+    }
+    out.clear();
+    return false;
+}
+
+/**
+ * @brief Reads an integer JSON value. Returns false if the key is missing
+ * or its value is not an integer.
+ */
+inline bool jsonNumberValue(std::string_view json, std::string_view key, long long& out) {
+    std::string_view value;
+    if (!findJSONValue(json, key, value)) return false;
+    auto result = std::from_chars(value.data(), value.data() + value.size(), out);
+    return result.ec == std::errc();
+}
+
+#endif // DECLUTTER_REQUEST_PARAMS_HPP
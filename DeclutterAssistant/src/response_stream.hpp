@@ -0,0 +1,158 @@
+#ifndef DECLUTTER_RESPONSE_STREAM_HPP
+#define DECLUTTER_RESPONSE_STREAM_HPP
+
+#include "compression.hpp"
+#include "http_server.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// ============================================================================
+// Chunked Response Streaming
+// ============================================================================
+
+// A chunk is sent once this much output has accumulated...
+constexpr size_t kStreamChunkBytes = 16 * 1024;
+// ...or when this long has passed since the last chunk, so sparse results
+// (and the very first ones) reach the client quickly
+constexpr std::chrono::milliseconds kStreamFlushInterval(50);
+// The producer blocks while this much output is queued on the socket
+constexpr size_t kStreamMaxQueuedBytes = 256 * 1024;
+
+/**
+ * @brief Writes a response body with Transfer-Encoding: chunked while it is
+ * still being produced (e.g. during a directory traversal).
+ *
+ * Used from a worker thread. Memory stays bounded: output is cut into
+ * chunks of kStreamChunkBytes and write() blocks while the socket is more
+ * than kStreamMaxQueuedBytes behind. write() returns false once the client
+ * has gone away, so the producer can stop.
+ *
+ * With a negotiated encoding every chunk is compressed and flushed, unless
+ * the whole body turns out to be smaller than kCompressionMinBytes.
+ */
+class ResponseStream {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ResponseStream(std::shared_ptr<Connection> client,
+                            ContentEncoding encoding = ContentEncoding::Identity)
+        : client(std::move(client)), encoding(encoding) {}
+
+    ~ResponseStream() {
+        end();
+    }
+
+    ResponseStream(const ResponseStream&) = delete;
+    ResponseStream& operator=(const ResponseStream&) = delete;
+
+    /**
+     * @brief Sets the status line and headers, which must announce
+     * Transfer-Encoding: chunked and carry no Content-Length. They go out
+     * with the first chunk, once it is known whether to compress.
+     */
+    void begin(std::string head) {
+        pendingHead = std::move(head);
+        started = true;
+        lastFlush = Clock::now();
+    }
+
+    bool write(const char* data, size_t size) {
+        if (ended) return false;
+        buffer.append(data, size);
+        if (buffer.size() >= kStreamChunkBytes || Clock::now() - lastFlush >= kStreamFlushInterval) {
+            return flushChunk();
+        }
+        return client->isOpen();
+    }
+
+    bool write(const std::string& data) {
+        return write(data.data(), data.size());
+    }
+
+    /**
+     * @brief Sends whatever is buffered as a chunk right away
+     */
+    bool flushChunk() {
+        if (!headSent) sendHead(true);
+        if (buffer.empty()) return client->isOpen();
+        lastFlush = Clock::now();
+
+        if (encoder) {
+            std::string encoded;
+            encoded.reserve(buffer.size() / 2 + 64);
+            if (!encoder->write(buffer.data(), buffer.size(), true, encoded)) {
+                client->close();
+                return false;
+            }
+            buffer.clear();
+            return sendChunk(std::move(encoded));
+        }
+
+        std::string data;
+        data.reserve(kStreamChunkBytes + kStreamChunkBytes / 4);
+        data.swap(buffer);
+        return sendChunk(std::move(data));
+    }
+
+    /**
+     * @brief Flushes the rest and writes the terminating zero-length chunk
+     */
+    void end() {
+        if (!started || ended) return;
+        if (!headSent) sendHead(buffer.size() >= kCompressionMinBytes);
+        flushChunk();
+        ended = true;
+        if (encoder) {
+            std::string trailer;
+            if (encoder->finish(trailer)) sendChunk(std::move(trailer));
+        }
+        client->send(std::string("0\r\n\r\n"));
+    }
+
+    bool isOpen() const {
+        return client->isOpen();
+    }
+
+private:
+    void sendHead(bool compress) {
+        if (compress && encoding != ContentEncoding::Identity) encoder = createEncoder(encoding);
+        if (encoder) {
+            // Insert before the blank line that ends the head
+            std::string headers = "Content-Encoding: ";
+            headers += contentEncodingName(encoding);
+            headers += "\r\nVary: Accept-Encoding\r\n";
+            pendingHead.insert(pendingHead.size() - 2, headers);
+        }
+        client->send(std::move(pendingHead));
+        headSent = true;
+    }
+
+    bool sendChunk(std::string data) {
+        if (data.empty()) return client->isOpen();
+
+        char sizeLine[24];
+        int length = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", data.size());
+        data += "\r\n";
+
+        HttpResponse chunk;
+        chunk.head.assign(sizeLine, (size_t)length);
+        chunk.body = std::move(data);
+        client->send(std::move(chunk));
+        return client->waitForDrain(kStreamMaxQueuedBytes);
+    }
+
+    std::shared_ptr<Connection> client;
+    ContentEncoding encoding;
+    std::unique_ptr<StreamEncoder> encoder;
+    std::string pendingHead;
+    std::string buffer;
+    Clock::time_point lastFlush;
+    bool started = false;
+    bool headSent = false;
+    bool ended = false;
+};
+
+#endif // DECLUTTER_RESPONSE_STREAM_HPP
@@ -0,0 +1,107 @@
+#ifndef DECLUTTER_ROUTER_HPP
+#define DECLUTTER_ROUTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// ============================================================================
+// Compile-Time Route Table
+// ============================================================================
+
+/**
+ * @brief One endpoint: exact method and path (without query string) mapped
+ * to an identifier the handler switches on.
+ */
+template <typename Id>
+struct Route {
+    std::string_view method;
+    std::string_view path;
+    Id id;
+};
+
+/**
+ * @brief FNV-1a over "METHOD path", mixed with a seed so the table builder
+ * can search for a seed without collisions.
+ */
+constexpr uint32_t routeHash(std::string_view method, std::string_view path, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ (seed * 16777619u);
+    for (char c : method) {
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+    hash ^= (unsigned char)' ';
+    hash *= 16777619u;
+    for (char c : path) {
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Perfect hash table over a fixed set of routes, built by the
+ * compiler. A lookup is one hash of the request line plus one comparison,
+ * however many routes there are.
+ */
+template <typename Id, size_t N>
+class RouteTable {
+public:
+    // At least four slots per route keeps the seed search short
+    static constexpr size_t kSlots = [] {
+        size_t size = 1;
+        while (size < N * 4) size *= 2;
+        return size;
+    }();
+
+    constexpr explicit RouteTable(const Route<Id> (&routes)[N]) : routes_{}, slots{}, seed(0) {
+        for (size_t i = 0; i < N; i++) routes_[i] = routes[i];
+        for (uint32_t candidate = 1; candidate < 100000; candidate++) {
+            if (tryBuild(candidate)) {
+                seed = candidate;
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief False if no collision-free seed was found (or a route is
+     * listed twice); checked with static_assert where the table is defined.
+     */
+    constexpr bool valid() const {
+        return seed != 0;
+    }
+
+    constexpr bool find(std::string_view method, std::string_view path, Id& id) const {
+        uint8_t slot = slots[routeHash(method, path, seed) & (kSlots - 1)];
+        if (slot == 0) return false;
+        const Route<Id>& route = routes_[slot - 1];
+        if (route.method != method || route.path != path) return false;
+        id = route.id;
+        return true;
+    }
+
+private:
+    constexpr bool tryBuild(uint32_t candidate) {
+        for (size_t i = 0; i < kSlots; i++) slots[i] = 0;
+        for (size_t i = 0; i < N; i++) {
+            size_t index = routeHash(routes_[i].method, routes_[i].path, candidate) & (kSlots - 1);
+            if (slots[index] != 0) return false;
+            slots[index] = (uint8_t)(i + 1);
+        }
+        return true;
+    }
+
+    Route<Id> routes_[N];
+    uint8_t slots[kSlots];
+    uint32_t seed;
+
+    static_assert(N < 255, "slot indices are stored in a byte");
+};
+
+template <typename Id, size_t N>
+constexpr RouteTable<Id, N> makeRouteTable(const Route<Id> (&routes)[N]) {
+    return RouteTable<Id, N>(routes);
+}
+
+#endif // DECLUTTER_ROUTER_HPP
@@ -0,0 +1,50 @@
+#ifndef DECLUTTER_ROUTES_HPP
+#define DECLUTTER_ROUTES_HPP
+
+#include "router.hpp"
+
+// ============================================================================
+// Route Table
+// ============================================================================
+
+enum class RouteId {
+    NotFound,
+    Drives,
+    Directories,
+    Files,
+    FilesRecursive,
+    ScanCleanup,
+    Cleanup,
+    DeleteFile,
+    DeleteFiles,
+    CreateFile,
+    Progress,
+    SubmitCleanupJob,
+    JobStatus,
+    JobResult,
+    Cancel,
+    Plan
+};
+
+constexpr Route<RouteId> kRoutes[] = {
+    {"GET", "/drives", RouteId::Drives},
+    {"GET", "/directories", RouteId::Directories},
+    {"GET", "/files", RouteId::Files},
+    {"GET", "/files-recursive", RouteId::FilesRecursive},
+    {"GET", "/scan-cleanup", RouteId::ScanCleanup},
+    {"POST", "/cleanup", RouteId::Cleanup},
+    {"DELETE", "/file", RouteId::DeleteFile},
+    {"DELETE", "/files", RouteId::DeleteFiles},
+    {"POST", "/file", RouteId::CreateFile},
+    {"GET", "/progress", RouteId::Progress},
+    {"POST", "/jobs/cleanup", RouteId::SubmitCleanupJob},
+    {"GET", "/jobs", RouteId::JobStatus},
+    {"GET", "/jobs/result", RouteId::JobResult},
+    {"POST", "/cancel", RouteId::Cancel},
+    {"POST", "/plans", RouteId::Plan},
+};
+
+constexpr auto kRouteTable = makeRouteTable(kRoutes);
+static_assert(kRouteTable.valid(), "no perfect hash for the route table (duplicate route?)");
+
+#endif // DECLUTTER_ROUTES_HPP
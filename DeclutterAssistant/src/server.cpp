@@ -1,19 +1,37 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <algorithm>
+#include <cerrno>
 #include <ctime>
 #include <cstdlib>
 #include <chrono>
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <windows.h>
 #include <filesystem>
-#include <shlobj.h>
+#include <functional>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
-#pragma comment(lib, "ws2_32.lib")
+#include "platform.hpp"
+#include "cancellation.hpp"
+#include "catalog_watcher.hpp"
+#include "compression.hpp"
+#include "directory_reader.hpp"
+#include "file_catalog.hpp"
+#include "file_filter.hpp"
+#include "file_table.hpp"
+#include "http_server.hpp"
+#include "job_scheduler.hpp"
+#include "match_set_cache.hpp"
+#include "parallel_walker.hpp"
+#include "progress_hub.hpp"
+#include "request_params.hpp"
+#include "response_stream.hpp"
+#include "routes.hpp"
+#include "single_flight.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 using namespace std::chrono;
@@ -35,39 +53,196 @@ string jsonEscape(const string& str) {
     return result;
 }
 
-string getCORSHeaders() {
-    return "Access-Control-Allow-Origin: *\r\n"
-           "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
-           "Access-Control-Allow-Headers: Content-Type\r\n";
+/**
+ * @brief Incrementally extracts the string elements of the first JSON array
+ * in a document, e.g. {"filepaths":["a","b"]}. Input may be split at any
+ * byte, so request bodies can be processed while they are still uploading.
+ */
+class JsonStringArrayReader {
+public:
+    template <typename Callback>
+    void feed(const string& data, Callback&& onString) {
+        for (char c : data) {
+            switch (state) {
+                case State::Seek:
+                    if (c == '"') state = State::SeekString;
+                    else if (c == '[') state = State::Array;
+                    break;
+                case State::SeekString:
+                    if (c == '\\') state = State::SeekEscape;
+                    else if (c == '"') state = State::Seek;
+                    break;
+                case State::SeekEscape:
+                    state = State::SeekString;
+                    break;
+                case State::Array:
+                    if (c == '"') {
+                        current.clear();
+                        state = State::String;
+                    } else if (c == ']') {
+                        state = State::Done;
+                    }
+                    break;
+                case State::String:
+                    if (c == '\\') {
+                        state = State::Escape;
+                    } else if (c == '"') {
+                        onString(current);
+                        state = State::Array;
+                    } else {
+                        current += c;
+                    }
+                    break;
+                case State::Escape:
+                    state = State::String;
+                    switch (c) {
+                        case 'n': current += '\n'; break;
+                        case 'r': current += '\r'; break;
+                        case 't': current += '\t'; break;
+                        case 'b': current += '\b'; break;
+                        case 'f': current += '\f'; break;
+                        case 'u':
+                            unicodeDigits = 0;
+                            codePoint = 0;
+                            state = State::Unicode;
+                            break;
+                        default: current += c; break;  // \\ \" \/
+                    }
+                    break;
+                case State::Unicode:
+                    codePoint = codePoint * 16 + (unsigned)max(0, hexDigitValue(c));
+                    if (++unicodeDigits == 4) {
+                        appendUtf8(codePoint, current);
+                        state = State::String;
+                    }
+                    break;
+                case State::Done:
+                    return;
+            }
+        }
+    }
+    
+    bool finished() const {
+        return state == State::Done;
+    }
+    
+private:
+    enum class State { Seek, SeekString, SeekEscape, Array, String, Escape, Unicode, Done };
+    
+    State state = State::Seek;
+    string current;
+    unsigned codePoint = 0;
+    int unicodeDigits = 0;
+};
+
+const string& getCORSHeaders() {
+    static const string headers =
+        "Access-Control-Allow-Origin: *\r\n"
+        "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
+        "Access-Control-Allow-Headers: Content-Type\r\n"
+        "Access-Control-Expose-Headers: Retry-After\r\n";
+    return headers;
 }
 
-string createHTTPResponse(int statusCode, const string& body, const string& contentType = "application/json") {
-    string status;
+const char* statusText(int statusCode) {
     switch (statusCode) {
-        case 200: status = "200 OK"; break;
-        case 400: status = "400 Bad Request"; break;
-        case 404: status = "404 Not Found"; break;
-        case 500: status = "500 Internal Server Error"; break;
-        default: status = "500 Internal Server Error";
+        case 200: return "200 OK";
+        case 202: return "202 Accepted";
+        case 400: return "400 Bad Request";
+        case 404: return "404 Not Found";
+        case 409: return "409 Conflict";
+        case 410: return "410 Gone";
+        case 426: return "426 Upgrade Required";
+        case 500: return "500 Internal Server Error";
+        case 503: return "503 Service Unavailable";
+        default: return "500 Internal Server Error";
+    }
+}
+
+/**
+ * @brief Builds the status line and headers; the body is moved in as a
+ * separate buffer and sent after the headers in the same vectored write.
+ * With a negotiated encoding, bodies of kCompressionMinBytes and more are
+ * compressed.
+ */
+HttpResponse createHTTPResponse(int statusCode, string body, const string& contentType = "application/json",
+                                ContentEncoding encoding = ContentEncoding::Identity) {
+    bool compressed = false;
+    if (encoding != ContentEncoding::Identity && body.size() >= kCompressionMinBytes) {
+        string encoded;
+        if (compressBuffer(encoding, body, encoded)) {
+            body.swap(encoded);
+            compressed = true;
+        }
     }
     
-    stringstream response;
-    response << "HTTP/1.1 " << status << "\r\n";
-    response << getCORSHeaders();
-    response << "Content-Type: " << contentType << "\r\n";
-    response << "Content-Length: " << body.length() << "\r\n";
-    response << "\r\n";
-    response << body;
-    return response.str();
+    HttpResponse response;
+    response.head.reserve(256);
+    response.head += "HTTP/1.1 ";
+    response.head += statusText(statusCode);
+    response.head += "\r\n";
+    response.head += getCORSHeaders();
+    response.head += "Content-Type: ";
+    response.head += contentType;
+    if (compressed) {
+        response.head += "\r\nContent-Encoding: ";
+        response.head += contentEncodingName(encoding);
+        response.head += "\r\nVary: Accept-Encoding";
+    }
+    response.head += "\r\nContent-Length: ";
+    response.head += to_string(body.length());
+    response.head += "\r\n\r\n";
+    response.body = move(body);
+    return response;
+}
+
+// How long a refused client is told to wait. Interactive work drains within
+// moments; a batch slot frees up only when a whole scan has finished.
+constexpr int kInteractiveRetryAfterSeconds = 1;
+constexpr int kBatchRetryAfterSeconds = 5;
+
+/**
+ * @brief 503 telling the client when to try again, for work that was
+ * refused at admission rather than queued without bound
+ */
+HttpResponse createBusyResponse(int retryAfterSeconds, const string& message) {
+    HttpResponse response = createHTTPResponse(503, "{\"success\":false,\"message\":\"" + jsonEscape(message) + "\"}");
+    // Before the blank line that ends the head
+    response.head.insert(response.head.size() - 2, "Retry-After: " + to_string(retryAfterSeconds) + "\r\n");
+    return response;
+}
+
+/**
+ * @brief Status line and headers for a body of unknown length that is sent
+ * with Transfer-Encoding: chunked (see ResponseStream).
+ */
+string createChunkedResponseHead(int statusCode, const string& contentType = "application/json") {
+    string head;
+    head.reserve(256);
+    head += "HTTP/1.1 ";
+    head += statusText(statusCode);
+    head += "\r\n";
+    head += getCORSHeaders();
+    head += "Content-Type: ";
+    head += contentType;
+    head += "\r\nTransfer-Encoding: chunked\r\n\r\n";
+    return head;
 }
 
 // ============================================================================
 // Path Normalization Helper
 // ============================================================================
 
+#ifdef _WIN32
+const char* const kDefaultRoot = "C:\\";
+#else
+const char* const kDefaultRoot = "/";
+#endif
+
 string normalizePath(const string& path) {
     string normalized = path;
     
+#ifdef _WIN32
     // Replace forward slashes with backslashes for Windows
     replace(normalized.begin(), normalized.end(), '/', '\\');
     
@@ -80,6 +255,12 @@ string normalizePath(const string& path) {
     if (normalized.length() > 3 && normalized.back() == '\\') {
         normalized.pop_back();
     }
+#else
+    // Remove trailing slash unless it's the root directory
+    if (normalized.length() > 1 && normalized.back() == '/') {
+        normalized.pop_back();
+    }
+#endif
     
     return normalized;
 }
@@ -92,6 +273,7 @@ string getDrives() {
     stringstream json;
     json << "{\"drives\":[";
     
+#ifdef _WIN32
     bool first = true;
     DWORD drives = GetLogicalDrives();
     for (int i = 0; i < 26; i++) {
@@ -102,6 +284,10 @@ string getDrives() {
             first = false;
         }
     }
+#else
+    // POSIX has a single root; mount points are browsed as directories
+    json << "\"/\"";
+#endif
     
     json << "]}";
     return json.str();
@@ -139,11 +325,89 @@ string listDirectories(const string& directory) {
     return json.str();
 }
 
-string listFiles(const string& directory) {
+// Catalogs of the roots configured on the command line; walks below them
+// read the catalog instead of the whole tree
+FileCatalog fileCatalog;
+
+// ============================================================================
+// Compact Listings (compact=1: a directory table instead of full paths)
+// ============================================================================
+//
+// A compact response gives each file as [directory, "name", size] and adds
+// "directories", a table of [parent, "name"] entries, and the "separator".
+// An entry's path is its parent's path, the separator unless that already
+// ends with one, and its name; an entry with parent -1 is a leading part of
+// a path. Parents come before their children, so the table can be resolved
+// front to back, or each path only when its row is shown.
+
+/**
+ * @brief Numbers the directories of one compact response, handing each new
+ * table entry (ancestors first) to `emit` as JSON when a file first needs it
+ */
+class CompactDirectories {
+public:
+    template <typename Emit>
+    uint32_t index(string_view directory, const Emit& emit) {
+        uint32_t node = tree.intern(directory);
+        for (; emitted < tree.size(); emitted++) {
+            uint32_t parent = tree.parent((uint32_t)emitted);
+            emit("[" + (parent == PathTree::kNone ? string("-1") : to_string(parent)) + ",\"" +
+                 jsonEscape(string(tree.name((uint32_t)emitted))) + "\"]");
+        }
+        return node;
+    }
+    
+private:
+    PathTree tree;
+    size_t emitted = 0;  // entries already handed out
+};
+
+/**
+ * @brief The fields a compact response ends with, around its directory table
+ */
+string compactTrailerJSON(const string& directoryTable) {
+    return "\"directories\":[" + directoryTable + "],\"separator\":\"" +
+           jsonEscape(string(1, (char)filesystem::path::preferred_separator)) + "\"";
+}
+
+string listFiles(const string& directory, bool compact) {
     stringstream json;
     json << "{\"files\":[";
     
     bool first = true;
+    auto addFile = [&](const string& name, const string& path, const string& type, uintmax_t size) {
+        if (!first) json << ",";
+        first = false;
+        if (compact) {
+            json << "[0,\"" << jsonEscape(name) << "\"," << size << "]";
+            return;
+        }
+        json << "{";
+        json << "\"name\":\"" << jsonEscape(name) << "\",";
+        json << "\"path\":\"" << jsonEscape(path) << "\",";
+        json << "\"type\":\"" << jsonEscape(type) << "\",";
+        json << "\"size\":" << size;
+        json << "}";
+    };
+    // All files share the one directory of the table
+    auto finish = [&](const string& listed) {
+        json << "]";
+        if (compact) json << "," << compactTrailerJSON("[-1,\"" + jsonEscape(listed) + "\"]");
+        json << "}";
+        return json.str();
+    };
+    
+    // A live catalog already holds the directory's files
+    string normalizedDir = normalizePath(directory);
+    string path;
+    bool live = fileCatalog.visitLiveDirectory(normalizedDir, [&](const CatalogEntry& entry) {
+        EntryStatus status;
+        entry.status(kStatSize, status);
+        path.clear();
+        if (!compact) entry.appendPath(path);
+        addFile(string(entry.name()), path, string(fileExtension(entry.name())), status.size);
+    });
+    if (live) return finish(normalizedDir);
     
     try {
         if (!filesystem::exists(directory) || !filesystem::is_directory(directory)) {
@@ -153,16 +417,8 @@ string listFiles(const string& directory) {
         for (const auto& entry : filesystem::directory_iterator(directory)) {
             try {
                 if (entry.is_regular_file()) {
-                    if (!first) json << ",";
-                    
-                    json << "{";
-                    json << "\"name\":\"" << jsonEscape(entry.path().filename().string()) << "\",";
-                    json << "\"path\":\"" << jsonEscape(entry.path().string()) << "\",";
-                    json << "\"type\":\"" << jsonEscape(entry.path().extension().string()) << "\",";
-                    json << "\"size\":" << entry.file_size();
-                    json << "}";
-                    
-                    first = false;
+                    addFile(entry.path().filename().string(), entry.path().string(),
+                            entry.path().extension().string(), entry.file_size());
                 }
             } catch (...) {
                 continue;
@@ -174,8 +430,212 @@ string listFiles(const string& directory) {
         return "{\"error\":\"Failed to list files\"}";
     }
     
-    json << "]}";
-    return json.str();
+    return finish(directory);
+}
+
+/**
+ * @brief The fields every response of a stoppable walk ends with
+ */
+string truncationJSON(CancelReason reason) {
+    if (reason == CancelReason::None) return "\"truncated\":false";
+    return string("\"truncated\":true,\"cancelReason\":\"") + cancelReasonName(reason) + "\"";
+}
+
+// Identical scans and listings running at the same time share one walk
+SingleFlight sharedWalks;
+
+// Threads reading directories for each scan or listing; set from the command line
+size_t walkThreads = 1;
+
+/**
+ * @brief Walks the tree below normalizedDir. A cataloged tree is answered
+ * from its catalog, in the order of an ordered walk, as long as the catalog
+ * holds the statFields the inspect step reads; anything else is walked.
+ * `inspect` is called with WalkEntry or CatalogEntry objects alike.
+ */
+template <typename Record, typename Inspect>
+bool walkTree(const string& normalizedDir, unsigned statFields, const typename ParallelWalker<Record>::Options& options,
+              const Inspect& inspect, const typename ParallelWalker<Record>::Deliver& deliver) {
+    if ((statFields & ~kCatalogStatFields) == 0) {
+        auto walk = fileCatalog.walk<Record>(normalizedDir, options.cancellation, inspect, deliver);
+        if (walk != FileCatalog::Walk::Unavailable) return walk == FileCatalog::Walk::Completed;
+    }
+    return ParallelWalker<Record>::run(normalizedDir, options, inspect, deliver);
+}
+
+/**
+ * @brief Relays a shared walk's records to one client as the elements of a
+ * JSON array, tallying what it sent, then leaves the walk. Entries of a
+ * compact response's directory table are collected in `directoryTable`
+ * instead, for the response to end with. Returns why this client stopped
+ * early, or None if it received the whole result.
+ */
+CancelReason relaySharedWalk(ResponseStream& stream, SharedWalk& walk, SharedWalk::Reader& reader,
+                             CancellationToken& cancellation, long long& count, uintmax_t& totalSize,
+                             string* directoryTable = nullptr) {
+    CancelReason stoppedBy = CancelReason::None;
+    vector<WalkRecord> batch;
+    string out;
+    bool first = true;
+    while (true) {
+        SharedWalk::Next next = walk.next(reader, batch, cancellation);
+        if (next == SharedWalk::Next::Finished) break;
+        if (next == SharedWalk::Next::Stopped) {
+            stoppedBy = cancellation.reason();
+            break;
+        }
+        if (next == SharedWalk::Next::Dropped) {
+            cout << "Dropped a client that stopped reading a shared walk" << endl;
+            stoppedBy = CancelReason::Stalled;
+            break;
+        }
+        
+        out.clear();
+        for (const auto& record : batch) {
+            if (record.directory) {
+                if (!directoryTable) continue;
+                if (!directoryTable->empty()) *directoryTable += ",";
+                *directoryTable += record.json;
+                continue;
+            }
+            if (!first) out += ",";
+            out += record.json;
+            first = false;
+            count++;
+            totalSize += record.size;
+        }
+        if (!stream.write(out)) {
+            stoppedBy = CancelReason::Disconnected;
+            break;
+        }
+    }
+    walk.leave(reader, stoppedBy);
+    return stoppedBy;
+}
+
+/**
+ * @brief Walks a tree for /files-recursive, adding each file to the shared
+ * walk as a JSON object, or a compact row. Files are rendered on the walking
+ * threads; a compact row gets its directory's index when it is delivered.
+ * Stops early once every reader has left.
+ */
+WalkOutcome walkAllFiles(const string& normalizedDir, bool ordered, bool compact, SharedWalk& walk) {
+    WalkOutcome outcome;
+    auto inspect = [compact](const auto& entry, vector<WalkRecord>& records) {
+        EntryStatus status;
+        if (!entry.isRegularFile() || !entry.status(kStatSize, status)) return false;
+        
+        string_view name = entry.name();
+        string item;
+        if (compact) {
+            // The row's start, "[<directory>", is added on delivery
+            item += ",\"";
+            item += jsonEscape(string(name));
+            item += "\",";
+            item += to_string(status.size);
+            item += "]";
+            records.push_back(WalkRecord{move(item), status.size});
+            return true;
+        }
+        item += "{\"name\":\"";
+        item += jsonEscape(string(name));
+        item += "\",\"path\":\"";
+        string path;
+        entry.appendPath(path);
+        item += jsonEscape(path);
+        item += "\",\"type\":\"";
+        item += jsonEscape(string(fileExtension(name)));
+        item += "\",\"size\":";
+        item += to_string(status.size);
+        item += "}";
+        records.push_back(WalkRecord{move(item), status.size});
+        return true;
+    };
+    CompactDirectories directories;
+    auto deliver = [&](const DirectoryBatch<WalkRecord>& batch) {
+        string row;
+        if (compact && !batch.records.empty()) {
+            uint32_t index = directories.index(batch.directory.string(),
+                                               [&](string entry) { walk.append(move(entry), 0, true); });
+            row = "[" + to_string(index);
+        }
+        for (WalkRecord& record : batch.records) {
+            if (compact) record.json.insert(0, row);
+            if (!walk.append(move(record.json), record.size)) return false;
+        }
+        return true;
+    };
+    
+    ParallelWalker<WalkRecord>::Options options;
+    options.threads = walkThreads;
+    options.ordered = ordered;
+    options.cancellation = &walk.cancellation();
+    if (!walkTree<WalkRecord>(normalizedDir, kStatSize, options, inspect, deliver) &&
+        walk.cancellation().reason() == CancelReason::None) {
+        outcome.success = false;
+        outcome.message = "Failed to list files";
+    }
+    outcome.stopReason = walk.cancellation().reason();
+    return outcome;
+}
+
+/**
+ * @brief Streams every file below a directory as {"files":[...]}. The list
+ * can be huge, so entries go out in chunks while the walk is running.
+ * Concurrent listings of the same directory share one walk. If this
+ * request's token fires, the files listed so far are closed off with
+ * "truncated".
+ */
+void streamAllFilesRecursive(const shared_ptr<Connection>& client, const string& directory, bool ordered,
+                             bool compact, ContentEncoding encoding, CancellationToken& cancellation) {
+    string normalizedDir = normalizePath(directory);
+    
+    try {
+        if (!filesystem::exists(normalizedDir) || !filesystem::is_directory(normalizedDir)) {
+            client->send(createHTTPResponse(200, "{\"error\":\"Directory does not exist or is not accessible\"}"));
+            return;
+        }
+    } catch (...) {
+        client->send(createHTTPResponse(200, "{\"error\":\"Directory does not exist or is not accessible\"}"));
+        return;
+    }
+    
+    SharedWalk::Reader reader;
+    bool started = false;
+    string key = "files\n" + normalizedDir + (ordered ? "\nordered" : "") + (compact ? "\ncompact" : "");
+    auto walk = sharedWalks.join(key,
+                                 [normalizedDir, ordered, compact](SharedWalk& w) {
+                                     return walkAllFiles(normalizedDir, ordered, compact, w);
+                                 },
+                                 reader, started);
+    if (!walk) {
+        client->send(createBusyResponse(kBatchRetryAfterSeconds, "Server busy, try again later"));
+        return;
+    }
+    if (!started) cout << "Sharing the listing already running for " << normalizedDir << endl;
+    
+    ResponseStream stream(client, encoding);
+    stream.begin(createChunkedResponseHead(200));
+    stream.write("{\"files\":[");
+    
+    long long count = 0;
+    uintmax_t totalSize = 0;
+    string directoryTable;
+    CancelReason stoppedBy = relaySharedWalk(stream, *walk, reader, cancellation, count, totalSize, &directoryTable);
+    if (!stream.isOpen()) return;
+    
+    string end = "],";
+    if (compact) end += compactTrailerJSON(directoryTable) + ",";
+    if (stoppedBy != CancelReason::None) {
+        stream.write(end + truncationJSON(stoppedBy) + "}");
+        return;
+    }
+    WalkOutcome outcome = walk->result();
+    if (!outcome.success) {
+        stream.write(end + "\"error\":\"" + jsonEscape(outcome.message) + "\"}");
+        return;
+    }
+    stream.write(end + truncationJSON(outcome.stopReason) + "}");
 }
 
 // ============================================================================
@@ -183,11 +643,12 @@ string listFiles(const string& directory) {
 // ============================================================================
 
 struct CleanupResult {
-    vector<string> matchedFiles;
+    FileTable matchedFiles;
     uintmax_t totalSize;
     int count;
     bool success;
     string message;
+    CancelReason stopReason;  // why the work ended early, if it did
 };
 
 /**
@@ -206,14 +667,140 @@ time_t fileTimeToTimeT(const filesystem::file_time_type& ftime) {
     }
 }
 
+// Receives the progress of every scan started with a progress id
+ProgressHub scanProgressHub;
+
+// Progress frames go out at most this often per scan
+constexpr milliseconds kProgressInterval(250);
+
+/**
+ * @brief Batches the counters of one running scan into periodic progress
+ * frames on scanProgressHub. Owned by the scanning worker, so the counters
+ * need no synchronisation. A background job's counters, if given, are
+ * mirrored with relaxed atomic increments for its status endpoint.
+ *
+ * The ETA is estimated from how many of the root's top-level directories
+ * have been read completely. Walk threads take directories in no fixed
+ * order, so each top-level subtree counts the directories of it still to
+ * come: it starts with itself, and every directory read adds its
+ * subdirectories and takes itself off. A directory always comes before its
+ * subdirectories, so the count reaches zero only at the subtree's end.
+ */
+class ScanProgress {
+public:
+    ScanProgress(string scanId, JobCounters* jobCounters = nullptr)
+        : scanId(move(scanId)), jobCounters(jobCounters), started(steady_clock::now()), lastPublish(started) {}
+    
+    /**
+     * @brief Called once per directory the walk has read, with its depth
+     * below the root and the number of subdirectories and files in it
+     */
+    void onDirectory(const filesystem::path& directory, int depth, size_t subdirectories, size_t files) {
+        if (depth == 0) {
+            // The root's own files count as one more unit of work
+            topLevelTotal = subdirectories + 1;
+            topLevelDone = 1;
+        } else {
+            filesystem::path topLevel = directory;
+            for (int level = depth; level > 1; level--) topLevel = topLevel.parent_path();
+            // Starts at 1 for the top-level directory itself
+            auto it = remaining.emplace(topLevel.native(), 1).first;
+            it->second += subdirectories;
+            if (--it->second == 0) {
+                remaining.erase(it);
+                topLevelDone++;
+            }
+        }
+        filesScanned += (long long)files;
+        if (jobCounters) jobCounters->filesScanned.fetch_add((long long)files, memory_order_relaxed);
+        if (steady_clock::now() - lastPublish < kProgressInterval) return;
+        publish("progress", directory.string(), false);
+    }
+    
+    void onMatch(uintmax_t size) {
+        filesMatched++;
+        bytesMatched += size;
+        if (jobCounters) {
+            jobCounters->filesMatched.fetch_add(1, memory_order_relaxed);
+            jobCounters->bytesMatched.fetch_add(size, memory_order_relaxed);
+        }
+    }
+    
+    void finish(bool success, const string& message) {
+        publish("done", "", true, success, &message);
+    }
+    
+private:
+    void publish(const char* type, const string& currentDirectory, bool final,
+                 bool success = true, const string* message = nullptr) {
+        auto now = steady_clock::now();
+        lastPublish = now;
+        if (scanId.empty() || !scanProgressHub.hasSubscribers(scanId)) return;
+        
+        long long elapsedMs = duration_cast<milliseconds>(now - started).count();
+        stringstream json;
+        json << "{\"type\":\"" << type << "\",";
+        json << "\"scan\":\"" << jsonEscape(scanId) << "\",";
+        json << "\"filesScanned\":" << filesScanned << ",";
+        json << "\"filesMatched\":" << filesMatched << ",";
+        json << "\"bytesMatched\":" << bytesMatched << ",";
+        json << "\"elapsedMs\":" << elapsedMs << ",";
+        if (final) {
+            json << "\"success\":" << (success ? "true" : "false") << ",";
+            json << "\"message\":\"" << jsonEscape(message ? *message : "") << "\"}";
+        } else {
+            double fraction = topLevelTotal > 0 ? (double)topLevelDone / topLevelTotal : 0;
+            json << "\"currentDirectory\":\"" << jsonEscape(currentDirectory) << "\",";
+            json << "\"etaMs\":";
+            if (fraction > 0.01) {
+                json << (long long)(elapsedMs * (1 - fraction) / fraction);
+            } else {
+                json << "null";
+            }
+            json << "}";
+        }
+        scanProgressHub.publish(scanId, json.str(), final);
+    }
+    
+    string scanId;
+    JobCounters* jobCounters;
+    steady_clock::time_point started;
+    steady_clock::time_point lastPublish;
+    size_t topLevelTotal = 0;
+    size_t topLevelDone = 0;
+    // Directories still to be read below each unfinished top-level directory
+    unordered_map<filesystem::path::string_type, size_t> remaining;
+    long long filesScanned = 0;
+    long long filesMatched = 0;
+    uintmax_t bytesMatched = 0;
+};
+
 /**
- * @brief Scans directory recursively for files matching cleanup criteria
+ * @brief Called for each match while scanning, with the table holding it;
+ * returning false stops the scan
  */
-CleanupResult scanForCleanup(const string& directory, const string& fileType, time_t beforeTimestamp) {
+using MatchCallback = function<bool(const FileTable& matches, size_t row)>;
+
+/**
+ * @brief Scans directory recursively for files the filter matches.
+ * With onMatch set, matches are handed to the callback as they are found
+ * instead of being collected in matchedFiles. If the cancellation token
+ * fires, the scan ends at the next directory with the matches found so far
+ * and stopReason set.
+ *
+ * The tree is read by walkThreads threads, which also evaluate the filter.
+ * Matches come out a directory at a time in no particular order, unless
+ * `ordered` asks for the sorted pre-order a sequential walk would give.
+ * A cataloged tree is read from its catalog instead, always in that order.
+ */
+CleanupResult scanForCleanup(const string& directory, const FileFilter& filter,
+                             const MatchCallback& onMatch = nullptr, ScanProgress* progress = nullptr,
+                             CancellationToken* cancellation = nullptr, bool ordered = false) {
     CleanupResult result;
     result.count = 0;
     result.totalSize = 0;
     result.success = false;
+    result.stopReason = CancelReason::None;
     
     // Normalize the path
     string normalizedDir = normalizePath(directory);
@@ -221,15 +808,7 @@ CleanupResult scanForCleanup(const string& directory, const string& fileType, ti
     cout << "\n=== SCAN STARTED ===" << endl;
     cout << "Original Directory: " << directory << endl;
     cout << "Normalized Directory: " << normalizedDir << endl;
-    cout << "File Type: " << fileType << endl;
-    cout << "Before Timestamp: " << beforeTimestamp << endl;
-    
-    // Convert threshold timestamp to readable date
-    char timeBuffer[80];
-    struct tm timeInfo;
-    localtime_s(&timeInfo, &beforeTimestamp);
-    strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
-    cout << "Threshold Date: " << timeBuffer << " (files OLDER than this will match)" << endl;
+    cout << "Filter: " << filter.text() << endl;
     
     try {
         // Check if directory exists
@@ -245,95 +824,105 @@ CleanupResult scanForCleanup(const string& directory, const string& fileType, ti
             return result;
         }
         
-        // Normalize file type
-        string normalizedType = fileType;
-        if (!normalizedType.empty() && normalizedType[0] != '.') {
-            normalizedType = "." + normalizedType;
-        }
-        transform(normalizedType.begin(), normalizedType.end(), normalizedType.begin(), ::tolower);
-        
-        cout << "Looking for files with extension: " << normalizedType << endl;
         cout << "Starting recursive scan..." << endl;
         
-        int filesScanned = 0;
-        int extensionMatches = 0;
+        long long filesScanned = 0;
+        // Files that passed the checks on their name (e.g. the extension)
+        atomic<long long> nameMatches{0};
+        bool receiverStopped = false;
         
-        // Recursively iterate through directory
-        for (const auto& entry : filesystem::recursive_directory_iterator(
-            normalizedDir,
-            filesystem::directory_options::skip_permission_denied)) {
+        // Runs on the walking threads: everything that needs the file itself
+        auto inspect = [&](const auto& entry, vector<FileRow>& matches) {
+            if (!entry.isRegularFile()) return false;
             
-            try {
-                if (entry.is_regular_file()) {
-                    filesScanned++;
-                    
-                    // Get file extension
-                    string extension = entry.path().extension().string();
-                    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-                    
-                    // Check if file extension matches
-                    if (extension == normalizedType) {
-                        extensionMatches++;
-                        
-                        // Get last write time
-                        auto ftime = filesystem::last_write_time(entry.path());
-                        time_t fileTime = fileTimeToTimeT(ftime);
-                        
-                        // Format file time for display
-                        struct tm fileTimeInfo;
-                        localtime_s(&fileTimeInfo, &fileTime);
-                        char fileTimeBuffer[80];
-                        strftime(fileTimeBuffer, sizeof(fileTimeBuffer), "%Y-%m-%d %H:%M:%S", &fileTimeInfo);
-                        
-                        // Debug output for first few matches
-                        if (extensionMatches <= 5) {
-                            cout << "\n[File #" << extensionMatches << "] " << entry.path().filename().string() << endl;
-                            cout << "  Full path: " << entry.path().string() << endl;
-                            cout << "  Extension: " << extension << " (matches: " << normalizedType << ")" << endl;
-                            cout << "  File modified: " << fileTimeBuffer << " (timestamp: " << fileTime << ")" << endl;
-                            cout << "  Threshold:     " << timeBuffer << " (timestamp: " << beforeTimestamp << ")" << endl;
-                            cout << "  File time < Threshold? " << (fileTime < beforeTimestamp ? "YES - MATCH!" : "NO - too recent") << endl;
-                            cout << "  Difference: " << (beforeTimestamp - fileTime) << " seconds" << endl;
-                        }
-                        
-                        // FIXED: The logic should be fileTime < beforeTimestamp
-                        // This means the file is OLDER than the threshold
-                        if (fileTime < beforeTimestamp) {
-                            result.matchedFiles.push_back(entry.path().string());
-                            result.totalSize += entry.file_size();
-                            result.count++;
-                            
-                            if (result.count <= 3) {
-                                cout << "  ✓ ADDED TO RESULTS!" << endl;
-                            }
-                        }
-                    }
-                    
-                    // Progress indicator every 100 files
-                    if (filesScanned % 100 == 0) {
-                        cout << "  ... scanned " << filesScanned << " files so far ..." << endl;
-                    }
+            // A match needs its size and time for the cleanup, so they come
+            // with the filter's own stat
+            thread_local FileFilter::Evaluation state;
+            state.reset();
+            FileFilter::Verdict verdict = filter.evaluate(entry, kStatSize | kStatModified, state);
+            if (verdict == FileFilter::Verdict::NameMismatch) return true;
+            nameMatches.fetch_add(1, memory_order_relaxed);
+            if (verdict == FileFilter::Verdict::Match) {
+                matches.push_back(FileRow{string(entry.name()), state.status.size, state.status.modified});
+            }
+            return true;
+        };
+        
+        // A receiver of the matches gets them a directory at a time from here
+        FileTable streamed;
+        FileTable& table = onMatch ? streamed : result.matchedFiles;
+        
+        // Runs one directory at a time: the counting, reporting and collecting
+        auto deliver = [&](const DirectoryBatch<FileRow>& batch) {
+            long long scannedBefore = filesScanned;
+            filesScanned += (long long)batch.files;
+            if (progress) progress->onDirectory(batch.directory, batch.depth, batch.subdirectories, batch.files);
+            
+            if (onMatch) streamed.clear();
+            uint32_t directoryId = batch.records.empty() ? 0 : table.addDirectory(batch.directory.string());
+            for (const FileRow& match : batch.records) {
+                result.totalSize += match.size;
+                result.count++;
+                if (progress) progress->onMatch(match.size);
+                size_t row = table.size();
+                table.add(directoryId, match.name, match.size, match.modified);
+                
+                // Debug output for first few matches
+                if (result.count <= 3) {
+                    cout << "  ✓ ADDED TO RESULTS: " << table.path(row) << " (" << match.size << " bytes)" << endl;
                 }
-            } catch (const exception& e) {
-                // Log individual file errors but continue processing
-                if (filesScanned < 10) {
-                    cerr << "Warning: Failed to process file - " << e.what() << endl;
+                
+                if (onMatch && !onMatch(table, row)) {
+                    receiverStopped = true;
+                    return false;
                 }
-                continue;
             }
+            
+            // Progress indicator every 100 files
+            if (filesScanned / 100 != scannedBefore / 100) {
+                cout << "  ... scanned " << filesScanned << " files so far ..." << endl;
+            }
+            return true;
+        };
+        
+        ParallelWalker<FileRow>::Options options;
+        options.threads = walkThreads;
+        options.ordered = ordered;
+        options.cancellation = cancellation;
+        unsigned statFields = filter.statFields() | kStatSize | kStatModified;
+        bool completed = walkTree<FileRow>(normalizedDir, statFields, options, inspect, deliver);
+        
+        if (receiverStopped) {
+            result.message = "Scan stopped";
+            cout << "Scan stopped by receiver after " << result.count << " match(es)" << endl;
+            return result;
+        }
+        if (!completed) {
+            if (cancellation) result.stopReason = cancellation->reason();
+            if (result.stopReason == CancelReason::None) {
+                result.message = "Scan failed after " + to_string(filesScanned) + " files";
+                cout << "ERROR: " << result.message << endl;
+                return result;
+            }
+            cout << "Scan stopped (" << cancelReasonName(result.stopReason) << ")" << endl;
         }
         
         cout << "\n=== SCAN COMPLETED ===" << endl;
         cout << "Total files scanned: " << filesScanned << endl;
-        cout << "Files with matching extension (" << normalizedType << "): " << extensionMatches << endl;
-        cout << "Files matching date criteria: " << result.count << endl;
+        cout << "Files passing the name checks: " << nameMatches << endl;
+        cout << "Files matching the filter: " << result.count << endl;
         cout << "Total size of matched files: " << result.totalSize << " bytes" << endl;
         
-        if (extensionMatches == 0) {
-            result.message = "No files found with extension " + normalizedType + " in directory";
+        string nameChecks = filter.describeNameChecks();
+        if (result.stopReason != CancelReason::None) {
+            result.message = string("Scan stopped (") + cancelReasonName(result.stopReason) + ") after " +
+                           to_string(filesScanned) + " files; found " + to_string(result.count) + " file(s) so far";
+        } else if (nameMatches == 0) {
+            result.message = nameChecks.empty() ? "No files found in directory"
+                                                : "No files found " + nameChecks + " in directory";
         } else if (result.count == 0) {
-            result.message = "Found " + to_string(extensionMatches) + " files with extension " + 
-                           normalizedType + ", but none are older than the specified date";
+            result.message = "Found " + to_string(nameMatches) + " files" + (nameChecks.empty() ? "" : " ") +
+                           nameChecks + ", but none " + filter.describeOtherChecks();
         } else {
             result.message = "Found " + to_string(result.count) + " file(s) to delete";
         }
@@ -352,86 +941,241 @@ CleanupResult scanForCleanup(const string& directory, const string& fileType, ti
 }
 
 /**
- * @brief Deletes files from the cleanup result
+ * @brief Deletes the matched files, counting into a background job's
+ * counters if given. Each file is looked at once more first, and kept if it
+ * changed or disappeared since it matched. Stops between files if the token
+ * fires.
  */
-CleanupResult executeCleanup(const CleanupResult& scanResult) {
+CleanupResult executeCleanup(const FileTable& matches, JobCounters* jobCounters = nullptr,
+                             CancellationToken* cancellation = nullptr) {
     CleanupResult result;
     result.count = 0;
     result.totalSize = 0;
     result.success = false;
+    result.stopReason = CancelReason::None;
     
     int failedCount = 0;
+    auto countFailure = [&] {
+        failedCount++;
+        if (jobCounters) jobCounters->filesFailed.fetch_add(1, memory_order_relaxed);
+    };
+    int skippedCount = 0;
     
     cout << "\n=== DELETION STARTED ===" << endl;
-    cout << "Files to delete: " << scanResult.matchedFiles.size() << endl;
+    cout << "Files to delete: " << matches.size() << endl;
     
-    for (const auto& filepath : scanResult.matchedFiles) {
-        try {
-            if (filesystem::exists(filepath)) {
-                uintmax_t fileSize = filesystem::file_size(filepath);
-                
-                if (filesystem::remove(filepath)) {
-                    result.matchedFiles.push_back(filepath);
-                    result.totalSize += fileSize;
-                    result.count++;
-                    
-                    if (result.count <= 5) {
-                        cout << "Deleted: " << filepath << endl;
-                    }
-                } else {
-                    failedCount++;
-                    cerr << "Failed to delete: " << filepath << endl;
-                }
-            } else {
-                failedCount++;
-                cerr << "File no longer exists: " << filepath << endl;
+    string path;
+    for (size_t row = 0; row < matches.size(); row++) {
+        if (cancellation && cancellation->stopRequested()) {
+            result.stopReason = cancellation->reason();
+            break;
+        }
+        path.clear();
+        matches.appendPath(row, path);
+        
+        // Read the way the scan read it, so unchanged files compare equal
+        EntryStatus now;
+        if (!statPath(path, kStatSize | kStatModified, now) || now.size != matches.size(row) ||
+            now.modified != matches.modified(row)) {
+            skippedCount++;
+            if (jobCounters) jobCounters->filesSkipped.fetch_add(1, memory_order_relaxed);
+            if (skippedCount <= 5) {
+                cerr << "Changed since the scan, kept: " << path << endl;
             }
-        } catch (const exception& e) {
-            failedCount++;
-            cerr << "Error deleting " << filepath << ": " << e.what() << endl;
+            continue;
+        }
+        
+        error_code ec;
+        if (filesystem::remove(path, ec)) {
+            result.matchedFiles.add(matches, row);
+            result.totalSize += now.size;
+            result.count++;
+            if (jobCounters) {
+                jobCounters->filesDeleted.fetch_add(1, memory_order_relaxed);
+                jobCounters->bytesFreed.fetch_add(now.size, memory_order_relaxed);
+            }
+            
+            if (result.count <= 5) {
+                cout << "Deleted: " << path << endl;
+            }
+        } else {
+            countFailure();
+            cerr << "Failed to delete " << path << ": " << ec.message() << endl;
         }
     }
     
     cout << "\nDeletion completed!" << endl;
     cout << "Successfully deleted: " << result.count << endl;
+    cout << "Changed since the scan: " << skippedCount << endl;
     cout << "Failed: " << failedCount << endl;
     
     result.success = (result.count > 0);
     
     stringstream msg;
     msg << "Deleted " << result.count << " file(s)";
+    if (skippedCount > 0) {
+        msg << ", kept " << skippedCount << " that changed since the scan";
+    }
     if (failedCount > 0) {
         msg << ", " << failedCount << " failed";
     }
+    if (result.stopReason != CancelReason::None) {
+        msg << ", stopped (" << cancelReasonName(result.stopReason) << ") before the remaining "
+            << matches.size() - result.count - skippedCount - failedCount;
+    }
     result.message = msg.str();
     
     return result;
 }
 
-string handleScanCleanup(const string& directory, const string& fileType, time_t beforeTimestamp) {
-    CleanupResult result = scanForCleanup(directory, fileType, beforeTimestamp);
+// Match sets of finished preview scans, waiting for the cleanup that deletes them
+MatchSetCache previewedScans;
+
+/**
+ * @brief Streams scan results while the scan runs. The file list comes first
+ * so it can go out immediately; the summary fields follow once it is done.
+ * Concurrent scans with the same criteria share one walk, and each client's
+ * progressId receives that walk's progress frames. A client stopped by its
+ * deadline or a cancel request still gets a summary, marked truncated.
+ */
+void handleScanCleanup(const shared_ptr<Connection>& client, const string& directory,
+                       shared_ptr<const FileFilter> filter, bool ordered, bool compact, ContentEncoding encoding,
+                       const string& progressId, CancellationToken& cancellation) {
+    string normalizedDir = normalizePath(directory);
+    string key = "scan\n" + normalizedDir + "\n" + filter->text() + (ordered ? "\nordered" : "") +
+                 (compact ? "\ncompact" : "");
+    // Progress is published once per walk, under an id derived from its key
+    string walkProgressId = "walk-" + to_string(hash<string>()(key));
+    // Before the walk can start, so its first frames reach this client too
+    scanProgressHub.addAlias(progressId, walkProgressId);
     
-    stringstream json;
-    json << "{";
-    json << "\"success\":" << (result.success ? "true" : "false") << ",";
-    json << "\"message\":\"" << jsonEscape(result.message) << "\",";
-    json << "\"count\":" << result.count << ",";
-    json << "\"totalSize\":" << result.totalSize << ",";
-    json << "\"files\":[";
+    SharedWalk::Reader reader;
+    bool started = false;
+    auto walk = sharedWalks.join(key, [=](SharedWalk& w) {
+        ScanProgress progress(walkProgressId);
+        // Kept so the cleanup can delete exactly this set without a second walk
+        auto previewed = make_shared<MatchSet>();
+        previewed->root = normalizedDir;
+        bool keepSet = true;
+        CompactDirectories directories;
+        uint32_t directoryIndex = 0;
+        
+        CleanupResult result = scanForCleanup(directory, *filter,
+            [&](const FileTable& matches, size_t row) {
+                if (keepSet && previewed->matches.size() < kMatchSetCacheMaxEntries) {
+                    previewed->matches.add(matches, row);
+                    previewed->totalSize += matches.size(row);
+                } else if (keepSet) {
+                    keepSet = false;
+                    previewed->matches = FileTable();
+                }
+                if (!compact) return w.append("\"" + jsonEscape(matches.path(row)) + "\"", matches.size(row));
+                // Rows of a directory come together
+                if (row == 0 || matches.directory(row) != matches.directory(row - 1)) {
+                    directoryIndex = directories.index(matches.directoryPath(matches.directory(row)),
+                                                       [&](string entry) { w.append(move(entry), 0, true); });
+                }
+                return w.append("[" + to_string(directoryIndex) + ",\"" + jsonEscape(string(matches.name(row))) +
+                                "\"," + to_string(matches.size(row)) + "]", matches.size(row));
+            }, &progress, &w.cancellation(), ordered);
+        progress.finish(result.success, result.message);
+        
+        WalkOutcome outcome;
+        outcome.success = result.success;
+        outcome.message = result.message;
+        outcome.stopReason = result.stopReason;
+        if (keepSet && result.success && result.stopReason == CancelReason::None && !previewed->matches.empty()) {
+            previewed->matches.compact();
+            // Tokens are single-use, so each client sharing the walk gets its own
+            shared_ptr<const MatchSet> set = move(previewed);
+            outcome.issueToken = [set] { return previewedScans.store(set); };
+        }
+        return outcome;
+    }, reader, started);
+    if (!walk) {
+        scanProgressHub.removeAlias(progressId, walkProgressId);
+        client->send(createBusyResponse(kBatchRetryAfterSeconds, "Server busy, try again later"));
+        return;
+    }
+    if (!started) cout << "Sharing the scan already running for " << normalizedDir << endl;
     
-    for (size_t i = 0; i < result.matchedFiles.size(); i++) {
-        if (i > 0) json << ",";
-        json << "\"" << jsonEscape(result.matchedFiles[i]) << "\"";
+    ResponseStream stream(client, encoding);
+    stream.begin(createChunkedResponseHead(200));
+    stream.write("{\"files\":[");
+    
+    long long count = 0;
+    uintmax_t totalSize = 0;
+    string directoryTable;
+    CancelReason stoppedBy = relaySharedWalk(stream, *walk, reader, cancellation, count, totalSize, &directoryTable);
+    scanProgressHub.removeAlias(progressId, walkProgressId);
+    if (!stream.isOpen()) return;
+    
+    WalkOutcome outcome;
+    if (stoppedBy == CancelReason::None) {
+        outcome = walk->result();
+    } else {
+        outcome.message = string("Scan stopped (") + cancelReasonName(stoppedBy) + "); found " +
+                          to_string(count) + " file(s) so far";
+        outcome.stopReason = stoppedBy;
     }
     
-    json << "]}";
+    stringstream json;
+    json << "],";
+    if (compact) json << compactTrailerJSON(directoryTable) << ",";
+    json << "\"success\":" << (outcome.success ? "true" : "false") << ",";
+    json << "\"message\":\"" << jsonEscape(outcome.message) << "\",";
+    json << "\"count\":" << count << ",";
+    json << "\"totalSize\":" << totalSize << ",";
+    string scanToken = outcome.issueToken ? outcome.issueToken() : "";
+    if (!scanToken.empty()) json << "\"scanToken\":\"" << scanToken << "\",";
+    json << truncationJSON(outcome.stopReason);
+    json << "}";
+    stream.write(json.str());
+}
+
+/**
+ * @brief The response of a cleanup, whichever way its files were found
+ */
+string cleanupResultJSON(const CleanupResult& deleteResult, size_t matched) {
+    stringstream json;
+    json << "{";
+    json << "\"success\":" << (deleteResult.success ? "true" : "false") << ",";
+    json << "\"message\":\"" << jsonEscape(deleteResult.message) << "\",";
+    json << "\"count\":" << deleteResult.count << ",";
+    json << "\"totalSize\":" << deleteResult.totalSize << ",";
+    json << "\"matched\":" << matched << ",";
+    json << truncationJSON(deleteResult.stopReason);
+    json << "}";
     return json.str();
 }
 
-string handleExecuteCleanup(const string& directory, const string& fileType, time_t beforeTimestamp) {
+/**
+ * @brief Scans and deletes. When run as a background job, the job's state
+ * and counters are kept up to date along the way.
+ *
+ * A deadline only bounds the scan: if it fires there, nothing is deleted,
+ * since the scan never saw the whole tree. Once deletion has started it runs
+ * to the end unless the cleanup is cancelled or its client disconnects.
+ */
+string handleExecuteCleanup(const string& directory, const FileFilter& filter, const string& progressId,
+                            CancellationToken& cancellation, Job* job = nullptr) {
+    JobCounters* jobCounters = job ? &job->counters : nullptr;
+    unique_ptr<ScanProgress> progress;
+    if (!progressId.empty() || job) {
+        progress.reset(new ScanProgress(progressId, jobCounters));
+    }
+    
     // First scan for files
-    CleanupResult scanResult = scanForCleanup(directory, fileType, beforeTimestamp);
+    if (job) job->setState(JobState::Scanning);
+    CleanupResult scanResult = scanForCleanup(directory, filter, nullptr, progress.get(), &cancellation);
+    if (progress) progress->finish(scanResult.success, scanResult.message);
     
+    if (scanResult.stopReason != CancelReason::None) {
+        stringstream json;
+        json << "{\"success\":false,\"message\":\"" << jsonEscape(scanResult.message) << "; nothing was deleted\",";
+        json << "\"count\":0," << truncationJSON(scanResult.stopReason) << "}";
+        return json.str();
+    }
     if (!scanResult.success || scanResult.count == 0) {
         stringstream json;
         json << "{\"success\":false,\"message\":\"" << jsonEscape(scanResult.message) << "\",\"count\":0}";
@@ -439,17 +1183,271 @@ string handleExecuteCleanup(const string& directory, const string& fileType, tim
     }
     
     // Execute deletion
-    CleanupResult deleteResult = executeCleanup(scanResult);
+    if (job) job->setState(JobState::Deleting);
+    cancellation.clearDeadline();
+    CleanupResult deleteResult = executeCleanup(scanResult.matchedFiles, jobCounters, &cancellation);
+    return cleanupResultJSON(deleteResult, scanResult.matchedFiles.size());
+}
+
+/**
+ * @brief Deletes the set a preview scan returned a token for. There is no
+ * walk: each file is only checked to be unchanged since the preview.
+ */
+string handlePreviewedCleanup(const MatchSet& previewed, CancellationToken& cancellation, Job* job = nullptr) {
+    if (job) {
+        job->counters.filesMatched.store((long long)previewed.matches.size(), memory_order_relaxed);
+        job->counters.bytesMatched.store(previewed.totalSize, memory_order_relaxed);
+        job->setState(JobState::Deleting);
+    }
+    cancellation.clearDeadline();
+    cout << "Deleting the previewed set of " << previewed.matches.size() << " file(s) in " << previewed.root << endl;
+    CleanupResult deleteResult = executeCleanup(previewed.matches, job ? &job->counters : nullptr, &cancellation);
+    return cleanupResultJSON(deleteResult, previewed.matches.size());
+}
+
+/**
+ * @brief Compiles the filter of a cleanup request: its "filter" expression,
+ * plus the classic fileType and beforeTimestamp criteria where given. On
+ * failure, returns null with `error` set to the response.
+ */
+shared_ptr<const FileFilter> buildCleanupFilter(const string& expression, const string* fileType,
+                                                const long long* beforeTimestamp, HttpResponse& error) {
+    auto filter = make_shared<FileFilter>();
+    string message;
+    if (!FileFilter::compile(expression, *filter, message)) {
+        error = createHTTPResponse(400, "{\"success\":false,\"message\":\"" + jsonEscape(message) + "\"}");
+        return nullptr;
+    }
+    if (fileType) filter->requireExtension(*fileType);
+    if (beforeTimestamp) filter->requireModifiedBefore((time_t)*beforeTimestamp);
+    if (filter->empty()) {
+        error = createHTTPResponse(400, "{\"success\":false,\"message\":\"Missing required parameters\"}");
+        return nullptr;
+    }
+    return filter;
+}
+
+/**
+ * @brief Takes the match set a preview returned `scanToken` for. Tokens are
+ * single-use. On failure, returns null with `error` set to the response.
+ */
+shared_ptr<const MatchSet> takePreviewedSet(const string& scanToken, const string& directory, HttpResponse& error) {
+    shared_ptr<const MatchSet> previewed = previewedScans.take(scanToken);
+    if (!previewed) {
+        error = createHTTPResponse(410, "{\"success\":false,\"message\":\"Scan results expired or already used, please scan again\"}");
+        return nullptr;
+    }
+    if (!directory.empty() && normalizePath(directory) != previewed->root) {
+        error = createHTTPResponse(400, "{\"success\":false,\"message\":\"Scan token belongs to a different directory\"}");
+        return nullptr;
+    }
+    return previewed;
+}
+
+// ============================================================================
+// Cleanup Plans (several policies, one walk)
+// ============================================================================
+
+// Policies one plan may hold; a file's verdicts are kept as one bit each
+constexpr size_t kMaxPlanPolicies = 64;
+
+/**
+ * @brief A file that matched at least one policy of a plan
+ */
+struct PlanHit {
+    FileRow file;
+    uint64_t policies;  // bit i set if policy i matched
+};
+
+/**
+ * @brief Evaluates every policy of a plan in the same walk of the directory,
+ * so the tree is read once however many policies there are. Each file's
+ * path and status are read at most once and shared by all the policies.
+ *
+ * Matches are streamed as they are found, each file once with the indexes
+ * of the policies it matched. The answer ends with each policy's count and
+ * byte total, in the order the policies were given. A completed plan also
+ * returns a scan token per policy, for POST /cleanup to delete that
+ * policy's set without walking again; only the sets that fit in the token
+ * cache together are kept for that.
+ */
+void handleCleanupPlan(const shared_ptr<Connection>& client, const string& directory,
+                       const vector<FileFilter>& policies, ContentEncoding encoding,
+                       const string& progressId, CancellationToken& cancellation) {
+    string normalizedDir = normalizePath(directory);
+    cout << "\n=== PLAN STARTED ===" << endl;
+    cout << "Directory: " << normalizedDir << endl;
+    for (size_t i = 0; i < policies.size(); i++) cout << "Policy " << i + 1 << ": " << policies[i].text() << endl;
+    
+    error_code ec;
+    if (!filesystem::is_directory(normalizedDir, ec)) {
+        string message = (filesystem::exists(normalizedDir, ec) ? "Path is not a directory: "
+                                                                : "Directory does not exist: ") + normalizedDir;
+        cout << "ERROR: " << message << endl;
+        client->send(createHTTPResponse(200, "{\"success\":false,\"message\":\"" + jsonEscape(message) + "\"}"));
+        return;
+    }
+    
+    // Whatever any policy reads is read for all of them in the first stat
+    unsigned statFields = kStatSize | kStatModified;
+    for (const FileFilter& policy : policies) statFields |= policy.statFields();
+    
+    // A policy's set is dropped once keeping it would take the plan's sets
+    // past what the token cache can hold
+    vector<shared_ptr<MatchSet>> sets;
+    vector<long long> counts(policies.size(), 0);
+    vector<uintmax_t> totals(policies.size(), 0);
+    size_t keptEntries = 0;
+    for (size_t i = 0; i < policies.size(); i++) {
+        sets.push_back(make_shared<MatchSet>());
+        sets.back()->root = normalizedDir;
+    }
+    
+    ScanProgress progress(progressId);
+    long long filesScanned = 0;
+    long long filesMatched = 0;
+    
+    auto inspect = [&](const auto& entry, vector<PlanHit>& hits) {
+        if (!entry.isRegularFile()) return false;
+        thread_local FileFilter::Evaluation state;
+        state.reset();
+        uint64_t matched = 0;
+        for (size_t i = 0; i < policies.size(); i++) {
+            if (policies[i].evaluate(entry, statFields, state) == FileFilter::Verdict::Match) {
+                matched |= uint64_t(1) << i;
+            }
+        }
+        if (matched) {
+            hits.push_back(PlanHit{FileRow{string(entry.name()), state.status.size, state.status.modified}, matched});
+        }
+        return true;
+    };
+    
+    ResponseStream stream(client, encoding);
+    stream.begin(createChunkedResponseHead(200));
+    stream.write("{\"files\":[");
+    
+    // Each set's entry for the directory being delivered, added on its first hit
+    constexpr uint32_t kNoDirectory = UINT32_MAX;
+    vector<uint32_t> directoryIds(sets.size());
+    string out;
+    string directoryPath;
+    
+    auto deliver = [&](const DirectoryBatch<PlanHit>& batch) {
+        filesScanned += (long long)batch.files;
+        progress.onDirectory(batch.directory, batch.depth, batch.subdirectories, batch.files);
+        if (batch.records.empty()) return true;
+        fill(directoryIds.begin(), directoryIds.end(), kNoDirectory);
+        directoryPath = batch.directory.string();
+        out.clear();
+        for (const PlanHit& hit : batch.records) {
+            if (filesMatched > 0) out += ",";
+            filesMatched++;
+            progress.onMatch(hit.file.size);
+            out += "{\"path\":\"" + jsonEscape((batch.directory / hit.file.name).string()) + "\",\"policies\":[";
+            bool firstPolicy = true;
+            for (size_t i = 0; i < sets.size(); i++) {
+                if (!(hit.policies & (uint64_t(1) << i))) continue;
+                if (!firstPolicy) out += ",";
+                out += to_string(i);
+                firstPolicy = false;
+                counts[i]++;
+                totals[i] += hit.file.size;
+                if (!sets[i]) continue;
+                if (keptEntries >= kMatchSetCacheMaxEntries) {
+                    keptEntries -= sets[i]->matches.size();
+                    sets[i].reset();
+                    continue;
+                }
+                FileTable& matches = sets[i]->matches;
+                if (directoryIds[i] == kNoDirectory) directoryIds[i] = matches.addDirectory(directoryPath);
+                matches.add(directoryIds[i], hit.file.name, hit.file.size, hit.file.modified);
+                sets[i]->totalSize += hit.file.size;
+                keptEntries++;
+            }
+            out += "]}";
+        }
+        // A client that went away ends the walk
+        return stream.write(out);
+    };
+    
+    ParallelWalker<PlanHit>::Options options;
+    options.threads = walkThreads;
+    options.cancellation = &cancellation;
+    bool completed = walkTree<PlanHit>(normalizedDir, statFields, options, inspect, deliver);
+    if (!stream.isOpen()) {
+        // Nobody gets the summary, but progress subscribers still get their done frame
+        CancelReason reason = cancellation.reason() != CancelReason::None ? cancellation.reason()
+                                                                          : CancelReason::Disconnected;
+        progress.finish(false, string("Plan stopped (") + cancelReasonName(reason) + ") after " +
+                                   to_string(filesScanned) + " files");
+        return;
+    }
+    
+    CancelReason stopReason = completed ? CancelReason::None : cancellation.reason();
+    bool success = completed || stopReason != CancelReason::None;
+    string message;
+    if (!success) {
+        message = "Plan failed after " + to_string(filesScanned) + " files";
+    } else if (stopReason != CancelReason::None) {
+        message = string("Plan stopped (") + cancelReasonName(stopReason) + ") after " + to_string(filesScanned) +
+                  " files; found " + to_string(filesMatched) + " file(s) so far";
+    } else {
+        message = "Found " + to_string(filesMatched) + " file(s) to delete across " + to_string(policies.size()) +
+                  " policies";
+    }
+    progress.finish(success, message);
+    cout << message << endl;
     
     stringstream json;
-    json << "{";
-    json << "\"success\":" << (deleteResult.success ? "true" : "false") << ",";
-    json << "\"message\":\"" << jsonEscape(deleteResult.message) << "\",";
-    json << "\"count\":" << deleteResult.count << ",";
-    json << "\"totalSize\":" << deleteResult.totalSize;
+    json << "],\"policies\":[";
+    for (size_t i = 0; i < sets.size(); i++) {
+        if (i > 0) json << ",";
+        json << "{\"filter\":\"" << jsonEscape(policies[i].text()) << "\",";
+        json << "\"count\":" << counts[i] << ",\"totalSize\":" << totals[i];
+        // Only a complete set can stand in for a walk at cleanup time
+        if (stopReason == CancelReason::None && success && sets[i] && !sets[i]->matches.empty()) {
+            sets[i]->matches.compact();
+            string token = previewedScans.store(sets[i]);
+            if (!token.empty()) json << ",\"scanToken\":\"" << token << "\"";
+        }
+        json << "}";
+    }
+    json << "],";
+    json << "\"success\":" << (success ? "true" : "false") << ",";
+    json << "\"message\":\"" << jsonEscape(message) << "\",";
+    json << "\"filesScanned\":" << filesScanned << ",";
+    json << "\"count\":" << filesMatched << ",";
+    json << truncationJSON(stopReason);
     json << "}";
-    
-    return json.str();
+    stream.write(json.str());
+}
+
+/**
+ * @brief Compiles the policies of a plan request, the filter expressions in
+ * the body's "policies" array (its only array). On failure, returns false
+ * with `error` set to the response.
+ */
+bool buildCleanupPlan(const string& body, vector<FileFilter>& policies, HttpResponse& error) {
+    string message;
+    JsonStringArrayReader reader;
+    reader.feed(body, [&](const string& expression) {
+        if (!message.empty()) return;
+        if (policies.size() == kMaxPlanPolicies) {
+            message = "A plan holds at most " + to_string(kMaxPlanPolicies) + " policies";
+            return;
+        }
+        policies.emplace_back();
+        if (!FileFilter::compile(expression, policies.back(), message)) {
+            message = "Policy " + to_string(policies.size()) + ": " + message;
+        } else if (policies.back().empty()) {
+            message = "Policy " + to_string(policies.size()) + " is empty";
+        }
+    });
+    if (message.empty() && policies.empty()) message = "Missing required parameters";
+    if (message.empty()) return true;
+    error = createHTTPResponse(400, "{\"success\":false,\"message\":\"" + jsonEscape(message) + "\"}");
+    return false;
 }
 
 // ============================================================================
@@ -467,6 +1465,56 @@ string handleDeleteFile(const string& filepath) {
     }
 }
 
+/**
+ * @brief Deletes every path listed in {"filepaths":[...]}. The list is read
+ * from the body as it streams in, so it can hold many thousands of paths.
+ */
+string handleDeleteFiles(const HttpRequest& request) {
+    JsonStringArrayReader reader;
+    int deletedCount = 0;
+    int failedCount = 0;
+    uintmax_t totalSize = 0;
+    
+    auto deleteOne = [&](const string& filepath) {
+        try {
+            if (filesystem::is_regular_file(filepath)) {
+                uintmax_t fileSize = filesystem::file_size(filepath);
+                if (filesystem::remove(filepath)) {
+                    deletedCount++;
+                    totalSize += fileSize;
+                    return;
+                }
+            }
+        } catch (...) {
+        }
+        failedCount++;
+    };
+    
+    string chunk;
+    while (!reader.finished() && request.nextBodyChunk(chunk)) {
+        reader.feed(chunk, deleteOne);
+    }
+    
+    stringstream msg;
+    msg << "Deleted " << deletedCount << " file(s)";
+    if (failedCount > 0) {
+        msg << ", " << failedCount << " failed";
+    }
+    if (!reader.finished()) {
+        msg << " (file list was incomplete)";
+    }
+    
+    stringstream json;
+    json << "{";
+    json << "\"success\":" << (reader.finished() && deletedCount > 0 ? "true" : "false") << ",";
+    json << "\"message\":\"" << jsonEscape(msg.str()) << "\",";
+    json << "\"count\":" << deletedCount << ",";
+    json << "\"failed\":" << failedCount << ",";
+    json << "\"totalSize\":" << totalSize;
+    json << "}";
+    return json.str();
+}
+
 string handleCreateFile(const string& directory, const string& filename) {
     try {
         filesystem::path destPath = filesystem::path(directory) / filename;
@@ -482,216 +1530,567 @@ string handleCreateFile(const string& directory, const string& filename) {
 }
 
 // ============================================================================
-// HTTP Request Parsing Functions
+// Background Cleanup Jobs
 // ============================================================================
 
-string parseRequestBody(const string& request) {
-    size_t bodyPos = request.find("\r\n\r\n");
-    if (bodyPos != string::npos) {
-        return request.substr(bodyPos + 4);
-    }
-    return "";
-}
+// Runs submitted cleanup jobs; owned by main()
+JobScheduler* cleanupJobs = nullptr;
 
-string extractJSONValue(const string& json, const string& key) {
-    string searchKey = "\"" + key + "\":\"";
-    size_t pos = json.find(searchKey);
-    if (pos == string::npos) return "";
+/**
+ * @brief Starts a cleanup in the background and answers right away with the
+ * job id, so long deletions are not cut off by HTTP timeouts.
+ */
+HttpResponse handleSubmitCleanupJob(const string& directory, shared_ptr<const FileFilter> filter,
+                                    const string& progressId, long long deadlineMs,
+                                    shared_ptr<const MatchSet> previewed) {
+    if (!previewed && (directory.empty() || !filter)) {
+        return createHTTPResponse(400, "{\"success\":false,\"message\":\"Missing required parameters\"}");
+    }
     
-    pos += searchKey.length();
-    size_t endPos = json.find("\"", pos);
-    if (endPos == string::npos) return "";
+    auto job = cleanupJobs->submit([directory, filter, progressId, previewed](Job& job) {
+        if (previewed) {
+            job.finish(handlePreviewedCleanup(*previewed, job.cancellation, &job));
+        } else {
+            job.finish(handleExecuteCleanup(directory, *filter, progressId, job.cancellation, &job));
+        }
+    });
+    if (!job) {
+        return createBusyResponse(kBatchRetryAfterSeconds, "Too many cleanup jobs, try again later");
+    }
+    // The deadline counts from submission; the job sees it from its next check on
+    if (deadlineMs > 0) job->cancellation.setDeadline(milliseconds(deadlineMs));
     
-    return json.substr(pos, endPos - pos);
+    cout << "Cleanup job " << job->id << " queued: " << directory;
+    if (filter) cout << " | Filter: " << filter->text();
+    cout << endl;
+    return createHTTPResponse(202, "{\"success\":true,\"jobId\":\"" + job->id + "\",\"status\":\"queued\"}");
 }
 
-long long extractJSONNumber(const string& json, const string& key) {
-    string searchKey = "\"" + key + "\":";
-    size_t pos = json.find(searchKey);
-    if (pos == string::npos) return 0;
-    
-    pos += searchKey.length();
-    size_t endPos = json.find_first_of(",}", pos);
-    if (endPos == string::npos) return 0;
+/**
+ * @brief Reports a job's state and live counters. Reads only atomics, so
+ * polling never slows the job down.
+ */
+HttpResponse handleJobStatus(const string& jobId) {
+    auto job = cleanupJobs->find(jobId);
+    if (!job) return createHTTPResponse(404, "{\"error\":\"Unknown job\"}");
     
-    string numStr = json.substr(pos, endPos - pos);
-    try {
-        return stoll(numStr);
-    } catch (...) {
-        return 0;
+    const JobCounters& counters = job->counters;
+    stringstream json;
+    json << "{";
+    json << "\"jobId\":\"" << job->id << "\",";
+    json << "\"status\":\"" << jobStateName(job->currentState()) << "\",";
+    json << "\"filesScanned\":" << counters.filesScanned.load(memory_order_relaxed) << ",";
+    json << "\"filesMatched\":" << counters.filesMatched.load(memory_order_relaxed) << ",";
+    json << "\"bytesMatched\":" << counters.bytesMatched.load(memory_order_relaxed) << ",";
+    json << "\"filesDeleted\":" << counters.filesDeleted.load(memory_order_relaxed) << ",";
+    json << "\"filesFailed\":" << counters.filesFailed.load(memory_order_relaxed) << ",";
+    json << "\"filesSkipped\":" << counters.filesSkipped.load(memory_order_relaxed) << ",";
+    json << "\"bytesFreed\":" << counters.bytesFreed.load(memory_order_relaxed) << ",";
+    json << "\"elapsedMs\":" << job->elapsedMs();
+    json << "}";
+    return createHTTPResponse(200, json.str());
+}
+
+/**
+ * @brief The job's result, in the same shape POST /cleanup answers with
+ */
+HttpResponse handleJobResult(const string& jobId) {
+    auto job = cleanupJobs->find(jobId);
+    if (!job) return createHTTPResponse(404, "{\"error\":\"Unknown job\"}");
+    if (!job->finished()) {
+        return createHTTPResponse(409, string("{\"error\":\"Job not finished\",\"status\":\"") +
+                                           jobStateName(job->currentState()) + "\"}");
     }
+    return createHTTPResponse(200, job->result());
 }
 
-string urlDecode(const string& str) {
-    string result;
-    for (size_t i = 0; i < str.length(); i++) {
-        if (str[i] == '%' && i + 2 < str.length()) {
-            string hex = str.substr(i + 1, 2);
-            char ch = (char)strtol(hex.c_str(), nullptr, 16);
-            result += ch;
-            i += 2;
-        } else if (str[i] == '+') {
-            result += ' ';
-        } else {
-            result += str[i];
-        }
+// ============================================================================
+// Cancellation
+// ============================================================================
+
+// Scans and listings in progress, by the progressId they were started with
+CancellationRegistry runningWalks;
+
+/**
+ * @brief Makes a walk stop when its client disconnects, when deadlineMs
+ * (if positive) has passed, or when POST /cancel names its progressId
+ */
+CancellationRegistry::Registration armCancellation(CancellationToken& cancellation,
+                                                   const shared_ptr<Connection>& client,
+                                                   const string& progressId, long long deadlineMs) {
+    cancellation.watch(client);
+    if (deadlineMs > 0) cancellation.setDeadline(milliseconds(deadlineMs));
+    return runningWalks.add(progressId, cancellation);
+}
+
+/**
+ * @brief Cancels the scans started with this progressId, or the job with
+ * this job id
+ */
+HttpResponse handleCancel(const string& id) {
+    size_t cancelled = id.empty() ? 0 : runningWalks.cancel(id);
+    if (!id.empty() && cleanupJobs->cancel(id)) cancelled++;
+    if (cancelled == 0) {
+        return createHTTPResponse(404, "{\"success\":false,\"message\":\"Nothing running with that id\"}");
     }
-    return result;
+    return createHTTPResponse(200, "{\"success\":true,\"cancelled\":" + to_string(cancelled) + "}");
 }
 
-string extractQueryParam(const string& request, const string& param) {
-    string searchKey = param + "=";
-    size_t pos = request.find(searchKey);
-    if (pos == string::npos) return "";
+// ============================================================================
+// Progress Channel
+// ============================================================================
+
+/**
+ * @brief Upgrades the request to a WebSocket that receives scan progress.
+ * "/progress?id=<progressId>" follows one scan, plain "/progress" every
+ * scan; {"subscribe":"<progressId>"} messages add further scans.
+ */
+void openProgressChannel(const shared_ptr<Connection>& client, const HttpRequest& req) {
+    auto session = make_shared<WebSocketSession>(client);
+    WebSocketSession* key = session.get();
+    weak_ptr<WebSocketSession> weak = session;
     
-    pos += searchKey.length();
-    size_t endPos = request.find_first_of(" &\r\n", pos);
-    if (endPos == string::npos) endPos = request.length();
+    session->setCloseHandler([key] { scanProgressHub.unsubscribe(key); });
+    session->setMessageHandler([weak](const string& message) {
+        string scanId;
+        auto self = weak.lock();
+        if (self && jsonStringValue(message, "subscribe", scanId)) {
+            scanProgressHub.subscribe(self, move(scanId));
+        }
+    });
     
-    string value = request.substr(pos, endPos - pos);
-    return urlDecode(value);
+    string scanId;
+    queryParam(req.target, "id", scanId);
+    scanProgressHub.subscribe(session, move(scanId));
+    session->accept(req);
+}
+
+// ============================================================================
+// Route Lookup
+// ============================================================================
+
+/**
+ * @brief Looks up the endpoint for a request by exact method and path
+ */
+RouteId resolveRoute(const HttpRequest& req) {
+    string_view target = req.target;
+    string_view path = target.substr(0, target.find('?'));
+    RouteId id = RouteId::NotFound;
+    kRouteTable.find(req.method, path, id);
+    return id;
 }
 
 // ============================================================================
 // Main Request Handler
 // ============================================================================
 
-void handleRequest(SOCKET client, const string& request) {
-    string response;
+void handleRequest(const shared_ptr<Connection>& client, const HttpRequest& req, RouteId route) {
+    HttpResponse response;
     
     // Handle CORS preflight
-    if (request.find("OPTIONS") == 0) {
+    if (req.method == "OPTIONS") {
         response = createHTTPResponse(200, "");
-        send(client, response.c_str(), response.length(), 0);
+        client->send(move(response));
         return;
     }
     
-    // Route handlers
-    if (request.find("GET /drives") == 0) {
-        string body = getDrives();
-        response = createHTTPResponse(200, body);
-    }
-    else if (request.find("GET /directories") == 0) {
-        string path = extractQueryParam(request, "path");
-        if (path.empty()) path = "C:\\";
-        string body = listDirectories(path);
-        response = createHTTPResponse(200, body);
-    }
-    else if (request.find("GET /files") == 0) {
-        string directory = extractQueryParam(request, "directory");
-        if (directory.empty()) directory = "C:\\";
-        cout << "Listing files in: " << directory << endl;
-        string body = listFiles(directory);
-        response = createHTTPResponse(200, body);
-    }
-    else if (request.find("GET /scan-cleanup") == 0) {
-        string directory = extractQueryParam(request, "directory");
-        string fileType = extractQueryParam(request, "fileType");
-        string timestampStr = extractQueryParam(request, "beforeTimestamp");
-        
-        if (directory.empty() || fileType.empty() || timestampStr.empty()) {
-            response = createHTTPResponse(400, "{\"success\":false,\"message\":\"Missing required parameters\"}");
-            send(client, response.c_str(), response.length(), 0);
+    // Listings repeat long path prefixes and compress well
+    ContentEncoding encoding = negotiateEncoding(req.headerView("accept-encoding"));
+    
+    // Decoded parameters go into buffers owned by the worker thread, which
+    // keep their capacity, so parsing a request does not allocate
+    thread_local string directory, fileType, filterText, filename, filepath, progressId, jobId, scanToken;
+    
+    switch (route) {
+        case RouteId::Drives: {
+            string body = getDrives();
+            response = createHTTPResponse(200, move(body));
+            break;
+        }
+        case RouteId::Directories: {
+            if (!queryParam(req.target, "path", directory)) directory = kDefaultRoot;
+            string body = listDirectories(directory);
+            response = createHTTPResponse(200, move(body), "application/json", encoding);
+            break;
+        }
+        case RouteId::Files: {
+            if (!queryParam(req.target, "directory", directory)) directory = kDefaultRoot;
+            long long compact = 0;
+            queryParam(req.target, "compact", compact);
+            cout << "Listing files in: " << directory << endl;
+            string body = listFiles(directory, compact != 0);
+            response = createHTTPResponse(200, move(body), "application/json", encoding);
+            break;
+        }
+        case RouteId::FilesRecursive: {
+            long long deadlineMs = 0;
+            if (!queryParam(req.target, "directory", directory)) directory = kDefaultRoot;
+            queryParam(req.target, "progressId", progressId);
+            queryParam(req.target, "deadlineMs", deadlineMs);
+            long long ordered = 0, compact = 0;
+            queryParam(req.target, "ordered", ordered);
+            queryParam(req.target, "compact", compact);
+            
+            CancellationToken cancellation;
+            auto registration = armCancellation(cancellation, client, progressId, deadlineMs);
+            cout << "Listing files recursively in: " << directory << endl;
+            streamAllFilesRecursive(client, directory, ordered != 0, compact != 0, encoding, cancellation);
             return;
         }
-        
-        time_t beforeTimestamp = 0;
-        try {
-            beforeTimestamp = stoll(timestampStr);
-        } catch (...) {
-            response = createHTTPResponse(400, "{\"success\":false,\"message\":\"Invalid timestamp format\"}");
-            send(client, response.c_str(), response.length(), 0);
+        case RouteId::ScanCleanup: {
+            long long beforeTimestamp = 0;
+            
+            // Either a filter expression or the classic fileType and beforeTimestamp
+            bool hasFilter = queryParam(req.target, "filter", filterText);
+            bool hasType = queryParam(req.target, "fileType", fileType);
+            bool hasTimestamp = hasQueryParam(req.target, "beforeTimestamp");
+            if (!queryParam(req.target, "directory", directory) || (!hasFilter && (!hasType || !hasTimestamp))) {
+                response = createHTTPResponse(400, "{\"success\":false,\"message\":\"Missing required parameters\"}");
+                break;
+            }
+            if (hasTimestamp && !queryParam(req.target, "beforeTimestamp", beforeTimestamp)) {
+                response = createHTTPResponse(400, "{\"success\":false,\"message\":\"Invalid timestamp format\"}");
+                break;
+            }
+            auto filter = buildCleanupFilter(filterText, hasType ? &fileType : nullptr,
+                                             hasTimestamp ? &beforeTimestamp : nullptr, response);
+            if (!filter) break;
+            
+            long long deadlineMs = 0;
+            queryParam(req.target, "progressId", progressId);
+            queryParam(req.target, "deadlineMs", deadlineMs);
+            long long ordered = 0, compact = 0;
+            queryParam(req.target, "ordered", ordered);
+            queryParam(req.target, "compact", compact);
+            
+            CancellationToken cancellation;
+            auto registration = armCancellation(cancellation, client, progressId, deadlineMs);
+            handleScanCleanup(client, directory, move(filter), ordered != 0, compact != 0, encoding, progressId,
+                              cancellation);
             return;
         }
-        
-        string body = handleScanCleanup(directory, fileType, beforeTimestamp);
-        response = createHTTPResponse(200, body);
-    }
-    else if (request.find("POST /cleanup") == 0) {
-        string body = parseRequestBody(request);
-        string directory = extractJSONValue(body, "directory");
-        string fileType = extractJSONValue(body, "fileType");
-        long long beforeTimestamp = extractJSONNumber(body, "beforeTimestamp");
-        
-        cout << "Executing cleanup: " << directory << " | Type: " << fileType << endl;
-        string responseBody = handleExecuteCleanup(directory, fileType, (time_t)beforeTimestamp);
-        response = createHTTPResponse(200, responseBody);
+        case RouteId::Cleanup: {
+            string body = req.readBody();
+            long long beforeTimestamp = 0, deadlineMs = 0;
+            jsonStringValue(body, "directory", directory);
+            bool hasType = jsonStringValue(body, "fileType", fileType);
+            bool hasTimestamp = jsonNumberValue(body, "beforeTimestamp", beforeTimestamp);
+            jsonStringValue(body, "filter", filterText);
+            jsonStringValue(body, "progressId", progressId);
+            jsonNumberValue(body, "deadlineMs", deadlineMs);
+            jsonStringValue(body, "scanToken", scanToken);
+            
+            shared_ptr<const MatchSet> previewed;
+            shared_ptr<const FileFilter> filter;
+            if (!scanToken.empty()) {
+                if (!(previewed = takePreviewedSet(scanToken, directory, response))) break;
+            } else {
+                // Without an expression the classic criteria apply, missing or not
+                bool classic = filterText.empty();
+                filter = buildCleanupFilter(filterText, classic || hasType ? &fileType : nullptr,
+                                            classic || hasTimestamp ? &beforeTimestamp : nullptr, response);
+                if (!filter) break;
+            }
+            
+            CancellationToken cancellation;
+            auto registration = armCancellation(cancellation, client, progressId, deadlineMs);
+            string responseBody;
+            if (previewed) {
+                responseBody = handlePreviewedCleanup(*previewed, cancellation);
+            } else {
+                cout << "Executing cleanup: " << directory << " | Filter: " << filter->text() << endl;
+                responseBody = handleExecuteCleanup(directory, *filter, progressId, cancellation);
+            }
+            response = createHTTPResponse(200, move(responseBody));
+            break;
+        }
+        case RouteId::SubmitCleanupJob: {
+            string body = req.readBody();
+            long long beforeTimestamp = 0, deadlineMs = 0;
+            jsonStringValue(body, "directory", directory);
+            bool hasType = jsonStringValue(body, "fileType", fileType);
+            bool hasTimestamp = jsonNumberValue(body, "beforeTimestamp", beforeTimestamp);
+            jsonStringValue(body, "filter", filterText);
+            jsonStringValue(body, "progressId", progressId);
+            jsonNumberValue(body, "deadlineMs", deadlineMs);
+            jsonStringValue(body, "scanToken", scanToken);
+            
+            shared_ptr<const MatchSet> previewed;
+            shared_ptr<const FileFilter> filter;
+            if (!scanToken.empty()) {
+                if (!(previewed = takePreviewedSet(scanToken, directory, response))) break;
+            } else {
+                bool classic = filterText.empty();
+                if (classic && fileType.empty()) {
+                    response = createHTTPResponse(400, "{\"success\":false,\"message\":\"Missing required parameters\"}");
+                    break;
+                }
+                filter = buildCleanupFilter(filterText, classic || hasType ? &fileType : nullptr,
+                                            classic || hasTimestamp ? &beforeTimestamp : nullptr, response);
+                if (!filter) break;
+            }
+            response = handleSubmitCleanupJob(directory, move(filter), progressId, deadlineMs, move(previewed));
+            break;
+        }
+        case RouteId::Plan: {
+            string body = req.readBody();
+            long long deadlineMs = 0;
+            jsonStringValue(body, "directory", directory);
+            jsonStringValue(body, "progressId", progressId);
+            jsonNumberValue(body, "deadlineMs", deadlineMs);
+            if (directory.empty()) {
+                response = createHTTPResponse(400, "{\"success\":false,\"message\":\"Missing required parameters\"}");
+                break;
+            }
+            vector<FileFilter> policies;
+            if (!buildCleanupPlan(body, policies, response)) break;
+            
+            CancellationToken cancellation;
+            auto registration = armCancellation(cancellation, client, progressId, deadlineMs);
+            handleCleanupPlan(client, directory, policies, encoding, progressId, cancellation);
+            return;
+        }
+        case RouteId::JobStatus: {
+            queryParam(req.target, "id", jobId);
+            response = handleJobStatus(jobId);
+            break;
+        }
+        case RouteId::JobResult: {
+            queryParam(req.target, "id", jobId);
+            response = handleJobResult(jobId);
+            break;
+        }
+        case RouteId::Cancel: {
+            queryParam(req.target, "id", jobId);
+            response = handleCancel(jobId);
+            break;
+        }
+        case RouteId::DeleteFiles: {
+            string responseBody = handleDeleteFiles(req);
+            response = createHTTPResponse(200, move(responseBody));
+            break;
+        }
+        case RouteId::DeleteFile: {
+            string body = req.readBody();
+            jsonStringValue(body, "filepath", filepath);
+            string responseBody = handleDeleteFile(filepath);
+            response = createHTTPResponse(200, move(responseBody));
+            break;
+        }
+        case RouteId::CreateFile: {
+            string body = req.readBody();
+            jsonStringValue(body, "directory", directory);
+            jsonStringValue(body, "filename", filename);
+            string responseBody = handleCreateFile(directory, filename);
+            response = createHTTPResponse(200, move(responseBody));
+            break;
+        }
+        case RouteId::Progress: {
+            if (!isWebSocketUpgrade(req)) {
+                response = createHTTPResponse(426, "{\"error\":\"Expected a WebSocket upgrade\"}");
+                break;
+            }
+            openProgressChannel(client, req);
+            return;
+        }
+        case RouteId::NotFound:
+            response = createHTTPResponse(404, "{\"error\":\"Endpoint not found\"}");
+            break;
     }
-    else if (request.find("DELETE /file") == 0) {
-        string body = parseRequestBody(request);
-        string filepath = extractJSONValue(body, "filepath");
-        string responseBody = handleDeleteFile(filepath);
-        response = createHTTPResponse(200, responseBody);
+    
+    client->send(move(response));
+}
+
+// ============================================================================
+// Request Dispatch
+// ============================================================================
+
+/**
+ * @brief Requests run in one of two lanes, each with its own bounded pool
+ * and admission queue. Interactive requests (listings, deletes, job polls)
+ * take milliseconds and are what the UI waits on; batch requests walk whole
+ * directory trees and can run for minutes. Neither lane can occupy the
+ * other's threads, so listings stay fast however many scans are running.
+ */
+enum class Lane { Interactive, Batch };
+
+Lane routeLane(RouteId route) {
+    switch (route) {
+        case RouteId::ScanCleanup:
+        case RouteId::Cleanup:
+        case RouteId::FilesRecursive:
+        case RouteId::Plan:
+            return Lane::Batch;
+        default:
+            return Lane::Interactive;
     }
-    else if (request.find("POST /file") == 0) {
-        string body = parseRequestBody(request);
-        string directory = extractJSONValue(body, "directory");
-        string filename = extractJSONValue(body, "filename");
-        string responseBody = handleCreateFile(directory, filename);
-        response = createHTTPResponse(200, responseBody);
+}
+
+/**
+ * @brief Runs the request on the executor, or answers 503 with Retry-After
+ * right away if its queue is full
+ */
+void dispatchRequest(Executor& executor, const shared_ptr<Connection>& client, HttpRequest request, RouteId route,
+                     int retryAfterSeconds) {
+    bool queued = executor.submit([client, request = move(request), route] {
+        handleRequest(client, request, route);
+        client->finishRequest();
+    });
+    if (!queued) {
+        client->send(createBusyResponse(retryAfterSeconds, "Server busy, try again later"));
+        client->finishRequest();
+    }
+}
+
+// ============================================================================
+// Server Configuration
+// ============================================================================
+
+/**
+ * @brief Resolves a positive setting from the command line flag, then the
+ * environment variable, falling back to the given default.
+ */
+size_t resolveNumericSetting(int argc, char* argv[], const string& flag, const char* envName, size_t fallback) {
+    long long requested = 0;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (argv[i] == flag) {
+            requested = atoll(argv[i + 1]);
+        }
     }
-    else {
-        response = createHTTPResponse(404, "{\"error\":\"Endpoint not found\"}");
+    if (requested <= 0) {
+        const char* env = getenv(envName);
+        if (env) requested = atoll(env);
     }
-    
-    send(client, response.c_str(), response.length(), 0);
+    return requested > 0 ? (size_t)requested : fallback;
+}
+
+/**
+ * @brief Resolves a text setting from the command line flag, then the
+ * environment variable; empty if neither is set.
+ */
+string resolveTextSetting(int argc, char* argv[], const string& flag, const char* envName) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (argv[i] == flag) return argv[i + 1];
+    }
+    const char* env = getenv(envName);
+    return env ? env : "";
+}
+
+/**
+ * @brief Splits a list of paths at the platform's PATH separator
+ */
+vector<string> splitPathList(const string& list) {
+#ifdef _WIN32
+    const char separator = ';';
+#else
+    const char separator = ':';
+#endif
+    vector<string> paths;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(separator, start);
+        if (end == string::npos) end = list.size();
+        if (end > start) paths.push_back(normalizePath(list.substr(start, end - start)));
+        start = end + 1;
+    }
+    return paths;
 }
 
 // ============================================================================
 // Main Server Entry Point
 // ============================================================================
 
-int main() {
+int main(int argc, char* argv[]) {
     cout << "========================================" << endl;
     cout << " Digital Declutter Assistant - Server" << endl;
     cout << " Enterprise-Grade File Management API" << endl;
     cout << "========================================" << endl;
     
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+    if (!initNetworking()) {
         cerr << "ERROR: WSAStartup failed" << endl;
         return 1;
     }
     
-    SOCKET serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket == INVALID_SOCKET) {
-        cerr << "ERROR: Socket creation failed" << endl;
-        WSACleanup();
-        return 1;
-    }
+    // Interactive lane: workers for the quick requests the UI waits on. The
+    // queue is generous, it only exists so overload is refused, not hoarded.
+    size_t hardwareThreads = thread::hardware_concurrency();
+    ThreadPool workers(resolveNumericSetting(argc, argv, "--workers", "DECLUTTER_WORKERS",
+                                          max<size_t>(4, hardwareThreads)),
+                       resolveNumericSetting(argc, argv, "--queue", "DECLUTTER_QUEUE", 1024));
+    
+    // Batch lane: scans run on a separate pool with a small queue; excess scans get a 503
+    ThreadPool scanWorkers(resolveNumericSetting(argc, argv, "--scan-workers", "DECLUTTER_SCAN_WORKERS",
+                                              max<size_t>(2, hardwareThreads / 2)),
+                           resolveNumericSetting(argc, argv, "--scan-queue", "DECLUTTER_SCAN_QUEUE", 64));
+    
+    // Background cleanup jobs: a few run at once, a bounded number wait
+    JobScheduler jobs(resolveNumericSetting(argc, argv, "--jobs", "DECLUTTER_JOBS", 2),
+                      resolveNumericSetting(argc, argv, "--job-queue", "DECLUTTER_JOB_QUEUE", 16));
+    cleanupJobs = &jobs;
+    
+    // Every walk in progress has a reader on a scan worker; walks whose
+    // readers all left get as many again to wind down
+    sharedWalks.setLimit(2 * scanWorkers.size());
     
-    sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(8080);
+    // Each scan or listing reads directories on this many threads
+    walkThreads = min(kMaxWalkThreads, resolveNumericSetting(argc, argv, "--walk-threads", "DECLUTTER_WALK_THREADS",
+                                                             max<size_t>(1, hardwareThreads)));
     
-    if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+    // Roots to keep a catalog of, saved in the catalog directory if one is set
+    fileCatalog.configure(splitPathList(resolveTextSetting(argc, argv, "--catalog-roots", "DECLUTTER_CATALOG_ROOTS")),
+                          resolveTextSetting(argc, argv, "--catalog-dir", "DECLUTTER_CATALOG_DIR"));
+    
+    // Where inotify is available, changes below the roots are applied as they
+    // happen and walks read the catalogs without refreshing them
+    CatalogWatcher catalogWatcher(fileCatalog);
+    bool catalogsLive = fileCatalog.rootCount() > 0 && catalogWatcher.start();
+    
+    // I/O threads only move bytes, so a few of them serve thousands of sockets
+    size_t ioThreads = resolveNumericSetting(argc, argv, "--io-threads", "DECLUTTER_IO_THREADS",
+                                          min<size_t>(4, max<size_t>(1, hardwareThreads / 4)));
+    
+    HttpServer server(ioThreads, [&](const shared_ptr<Connection>& client, HttpRequest request) {
+        RouteId route = resolveRoute(request);
+        if (routeLane(route) == Lane::Batch) {
+            dispatchRequest(scanWorkers, client, move(request), route, kBatchRetryAfterSeconds);
+        } else {
+            dispatchRequest(workers, client, move(request), route, kInteractiveRetryAfterSeconds);
+        }
+    });
+    
+    server.setIdleTimeout((int)resolveNumericSetting(argc, argv, "--idle-timeout", "DECLUTTER_IDLE_TIMEOUT", 15));
+    
+    if (!server.listen(8080)) {
         cerr << "ERROR: Bind failed (port 8080 may be in use)" << endl;
-        closesocket(serverSocket);
-        WSACleanup();
+        cleanupNetworking();
         return 1;
     }
     
-    listen(serverSocket, 5);
-    
     cout << endl;
     cout << "✓ Server running on http://localhost:8080" << endl;
     cout << "✓ CORS enabled for development" << endl;
+    cout << "✓ " << server.ioThreadCount() << " I/O threads, " << workers.size() << " worker threads (queue "
+         << workers.queueLimit() << "), " << scanWorkers.size() << " scan threads (queue "
+         << scanWorkers.queueLimit() << ")" << endl;
+    cout << "✓ " << jobs.concurrency() << " concurrent cleanup jobs (queue " << jobs.queueLimit() << ")" << endl;
+    cout << "✓ " << walkThreads << " directory walking threads per scan" << endl;
+    if (fileCatalog.rootCount() > 0) {
+        cout << "✓ File catalog kept for " << fileCatalog.rootCount() << " root(s)"
+             << (catalogsLive ? ", following changes" : "") << endl;
+    }
+    cout << "✓ Keep-alive enabled (idle timeout " << server.idleTimeoutSeconds() << "s)" << endl;
     cout << "✓ Ready to accept connections..." << endl;
     cout << endl;
     
-    while (true) {
-        SOCKET clientSocket = accept(serverSocket, NULL, NULL);
-        if (clientSocket == INVALID_SOCKET) continue;
-        
-        char buffer[4096] = {0};
-        recv(clientSocket, buffer, 4096, 0);
-        
-        handleRequest(clientSocket, string(buffer));
-        closesocket(clientSocket);
-    }
+    server.run();
     
-    closesocket(serverSocket);
-    WSACleanup();
+    catalogWatcher.stop();
+    fileCatalog.flush();
+    scanWorkers.shutdown();
+    sharedWalks.shutdown();
+    workers.shutdown();
+    jobs.shutdown();
+    cleanupJobs = nullptr;
+    cleanupNetworking();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,334 @@
+#ifndef DECLUTTER_SINGLE_FLIGHT_HPP
+#define DECLUTTER_SINGLE_FLIGHT_HPP
+
+#include "cancellation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Single-Flight Walks (identical concurrent requests share one traversal)
+// ============================================================================
+//
+// The walk runs once, on its own producer thread, and appends its results
+// as records. Every request for it, the first one included, reads the
+// records at its own pace and writes them to its own client, so each keeps
+// its own encoding, backpressure and cancellation. A reader that falls a
+// full buffer behind holds the walk up, but only for so long: then it is
+// dropped and its response ends truncated, and the others go on.
+
+// Records are kept from the start while they fit in this many bytes, so a
+// request arriving mid-walk still gets the whole result. Past it, records
+// every reader has passed are dropped and nobody new can join.
+constexpr size_t kSharedWalkReplayBytes = 4 * 1024 * 1024;
+
+// Readers waiting for records wake up this often to check their own
+// cancellation token
+constexpr std::chrono::milliseconds kSharedWalkPollInterval(50);
+
+// A reader that is behind and has not asked for records for this long while
+// the buffer is full is dropped
+constexpr std::chrono::seconds kSharedWalkStallTimeout(30);
+
+// Walks running at once unless SingleFlight::setLimit says otherwise; each
+// has a producer thread and its walking threads
+constexpr size_t kMaxSharedWalks = 16;
+
+/**
+ * @brief One result of a walk, already rendered as JSON
+ */
+struct WalkRecord {
+    std::string json;
+    uintmax_t size;
+    bool directory = false;  // an entry of the response's directory table, not an item
+};
+
+/**
+ * @brief How the walk ended, for the summary every reader sends
+ */
+struct WalkOutcome {
+    bool success = true;
+    std::string message;
+    CancelReason stopReason = CancelReason::None;
+    // Hands each reader its own token for a cached copy of the result; empty
+    // if none was kept
+    std::function<std::string()> issueToken;
+};
+
+class SharedWalk {
+public:
+    // Dropped: the reader fell behind for too long and was left out
+    enum class Next { Records, Finished, Stopped, Dropped };
+
+    // ---- producer side ----
+
+    /**
+     * @brief Fires once every reader has left; the producer passes it to the
+     * traversal so an abandoned walk stops at its next directory
+     */
+    CancellationToken& cancellation() {
+        return abandoned;
+    }
+
+    /**
+     * @brief Adds a record. Blocks while the buffer is full and a reader is
+     * behind, dropping readers that stay behind for kSharedWalkStallTimeout.
+     * Returns false once every reader has left.
+     */
+    bool append(std::string json, uintmax_t size, bool directory = false) {
+        std::unique_lock<std::mutex> lock(mutex);
+        bufferedBytes += json.size();
+        records.push_back(WalkRecord{std::move(json), size, directory});
+        changed.notify_all();
+        while (bufferedBytes > kSharedWalkReplayBytes && readers > 0) {
+            joinable = false;
+            trim();
+            if (bufferedBytes <= kSharedWalkReplayBytes) break;
+            if (changed.wait_until(lock, stalledSince() + kSharedWalkStallTimeout) == std::cv_status::timeout) {
+                dropStalled();
+            }
+        }
+        return readers > 0;
+    }
+
+    void complete(WalkOutcome result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        outcome = std::move(result);
+        done = true;
+        changed.notify_all();
+    }
+
+    // ---- reader side ----
+
+    /**
+     * @brief A reader's position; created by SingleFlight::join
+     */
+    struct Reader {
+        size_t id = 0;
+        size_t cursor = 0;
+    };
+
+    /**
+     * @brief Waits for records past the reader's cursor and moves copies of
+     * them into `out`. Returns Finished once the walk is done and everything
+     * has been read, Stopped if the reader's own token fired first, Dropped
+     * if it stalled the walk and was left behind.
+     */
+    Next next(Reader& reader, std::vector<WalkRecord>& out, CancellationToken& readerCancellation) {
+        out.clear();
+        while (true) {
+            // Checked between batches, and while waiting, without the lock
+            if (readerCancellation.stopRequested()) return Next::Stopped;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            auto position = cursors.find(reader.id);
+            if (position == cursors.end()) return Next::Dropped;
+            position->second.asked = std::chrono::steady_clock::now();
+            if (reader.cursor < base + records.size()) {
+                for (size_t i = reader.cursor - base; i < records.size(); i++) out.push_back(records[i]);
+                reader.cursor = base + records.size();
+                position->second.position = reader.cursor;
+                changed.notify_all();  // the producer may be waiting for us
+                return Next::Records;
+            }
+            if (done) return Next::Finished;
+            changed.wait_for(lock, kSharedWalkPollInterval);
+        }
+    }
+
+    /**
+     * @brief Only valid after next() returned Finished
+     */
+    WalkOutcome result() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return outcome;
+    }
+
+    /**
+     * @brief Detaches a reader; the last one to leave early stops the walk
+     */
+    void leave(const Reader& reader, CancelReason why) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // A dropped reader has been counted out already
+        if (cursors.erase(reader.id) == 0) return;
+        if (--readers == 0 && !done) {
+            joinable = false;
+            abandoned.cancel(why == CancelReason::None ? CancelReason::Disconnected : why);
+        }
+        changed.notify_all();
+    }
+
+private:
+    friend class SingleFlight;
+
+    /**
+     * @brief Registers a reader starting at the first record, unless the
+     * walk has already dropped records or been abandoned
+     */
+    bool tryJoin(Reader& reader) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!joinable) return false;
+        reader.id = nextReaderId++;
+        reader.cursor = 0;
+        cursors[reader.id] = Cursor{0, std::chrono::steady_clock::now()};
+        readers++;
+        return true;
+    }
+
+    /**
+     * @brief Drops the records every reader has passed
+     */
+    void trim() {
+        size_t oldest = base + records.size();
+        for (const auto& entry : cursors) oldest = std::min(oldest, entry.second.position);
+        while (base < oldest) {
+            bufferedBytes -= records.front().json.size();
+            records.pop_front();
+            base++;
+        }
+    }
+
+    /**
+     * @brief When the reader behind that has gone longest without asking
+     * for records last asked
+     */
+    std::chrono::steady_clock::time_point stalledSince() const {
+        auto oldest = std::chrono::steady_clock::now();
+        for (const auto& entry : cursors) {
+            if (entry.second.position < base + records.size()) oldest = std::min(oldest, entry.second.asked);
+        }
+        return oldest;
+    }
+
+    /**
+     * @brief Leaves out the readers behind that have not asked for records
+     * for kSharedWalkStallTimeout; they find out in next()
+     */
+    void dropStalled() {
+        auto limit = std::chrono::steady_clock::now() - kSharedWalkStallTimeout;
+        for (auto it = cursors.begin(); it != cursors.end();) {
+            if (it->second.position < base + records.size() && it->second.asked <= limit) {
+                it = cursors.erase(it);
+                readers--;
+            } else {
+                ++it;
+            }
+        }
+        if (readers == 0 && !done) abandoned.cancel(CancelReason::Stalled);
+        changed.notify_all();
+    }
+
+    struct Cursor {
+        size_t position;                              // next record to read
+        std::chrono::steady_clock::time_point asked;  // when it last called next()
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<WalkRecord> records;
+    size_t base = 0;  // index of records.front() since the walk began
+    size_t bufferedBytes = 0;
+    std::unordered_map<size_t, Cursor> cursors;  // by reader id
+    size_t nextReaderId = 1;
+    size_t readers = 0;
+    bool joinable = true;
+    bool done = false;
+    WalkOutcome outcome;
+    CancellationToken abandoned;
+};
+
+/**
+ * @brief Walks in flight by request key. A request joins the walk running
+ * under its key if it can still replay it from the start; otherwise it
+ * starts a new one.
+ */
+class SingleFlight {
+public:
+    using Producer = std::function<WalkOutcome(SharedWalk&)>;
+
+    ~SingleFlight() {
+        shutdown();
+    }
+
+    /**
+     * @brief How many walks may run at once; more wait for a running one
+     * to end by being refused
+     */
+    void setLimit(size_t walks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        limit = std::max<size_t>(walks, 1);
+    }
+
+    /**
+     * @brief Joins or starts the walk for `key`. `started` tells whether this
+     * call started it. Returns null if the limit of running walks is reached
+     * or no producer thread could be started.
+     */
+    std::shared_ptr<SharedWalk> join(const std::string& key, const Producer& produce, SharedWalk::Reader& reader,
+                                     bool& started) {
+        std::lock_guard<std::mutex> lock(mutex);
+        started = false;
+        auto it = inFlight.find(key);
+        if (it != inFlight.end() && it->second->tryJoin(reader)) return it->second;
+
+        if (producers >= limit) return nullptr;
+        auto walk = std::make_shared<SharedWalk>();
+        walk->tryJoin(reader);
+        try {
+            producers++;
+            std::thread([this, key, walk, produce] {
+                WalkOutcome outcome;
+                try {
+                    outcome = produce(*walk);
+                } catch (...) {
+                    outcome.success = false;
+                    outcome.message = "Walk failed";
+                }
+                walk->complete(std::move(outcome));
+                finish(key, walk);
+            }).detach();
+        } catch (const std::system_error&) {
+            producers--;
+            return nullptr;
+        }
+        inFlight[key] = walk;
+        started = true;
+        return walk;
+    }
+
+    /**
+     * @brief Waits for the producer threads; their readers must be gone
+     */
+    void shutdown() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return producers == 0; });
+    }
+
+private:
+    void finish(const std::string& key, const std::shared_ptr<SharedWalk>& walk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = inFlight.find(key);
+        if (it != inFlight.end() && it->second == walk) inFlight.erase(it);
+        if (--producers == 0) idle.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::unordered_map<std::string, std::shared_ptr<SharedWalk>> inFlight;
+    size_t producers = 0;
+    size_t limit = kMaxSharedWalks;
+};
+
+#endif // DECLUTTER_SINGLE_FLIGHT_HPP
@@ -0,0 +1,117 @@
+#ifndef DECLUTTER_THREAD_POOL_HPP
+#define DECLUTTER_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Executors
+// ============================================================================
+
+/**
+ * @brief Something that runs request handlers. The server picks an executor
+ * per request, so different kinds of work can be given different pools.
+ */
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    /**
+     * @brief Schedules a task. Returns false if the executor refuses it
+     * (queue full or shutting down); the caller must then answer itself.
+     */
+    virtual bool submit(std::function<void()> task) = 0;
+};
+
+/**
+ * @brief Fixed-size pool of worker threads draining a FIFO task queue.
+ *
+ * The acceptor pushes one task per request; any idle worker picks it up,
+ * so a long-running scan only occupies the worker that is serving it.
+ * With maxQueued > 0 the queue is bounded and submit() fails when full.
+ */
+class ThreadPool : public Executor {
+public:
+    explicit ThreadPool(size_t threadCount, size_t maxQueued = 0)
+        : maxQueued(maxQueued) {
+        if (threadCount == 0) threadCount = 1;
+        workers.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() override {
+        shutdown();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    bool submit(std::function<void()> task) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return false;
+            if (maxQueued > 0 && tasks.size() >= maxQueued) return false;
+            tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Stops accepting tasks, drains the queue and joins all workers.
+     */
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    size_t queueLimit() const {
+        return maxQueued;
+    }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            try {
+                task();
+            } catch (...) {
+                // A failing request must never take a worker down with it
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    size_t maxQueued;
+    bool stopping = false;
+};
+
+#endif // DECLUTTER_THREAD_POOL_HPP
@@ -1,33 +1,278 @@
-/*
- * Copyright (c) 2014, Peter Thorson. All rights reserved.
- *
- * Redistribution and use in source and binary forms, with or without
- * modification, are permitted provided that the following conditions are met:
- *     * Redistributions of source code must retain the above copyright
- *       notice, this list of conditions and the following disclaimer.
- *     * Redistributions in binary form must reproduce the above copyright
- *       notice, this list of conditions and the following disclaimer in the
- *       documentation and/or other materials provided with the distribution.
- *     * Neither the name of the WebSocket++ Project nor the
- *       names of its contributors may be used to endorse or promote products
- *       derived from this software without specific prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
- * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
- * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
- * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
- * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
- * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
- * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- *
+#ifndef DECLUTTER_WS_SERVER_HPP
+#define DECLUTTER_WS_SERVER_HPP
+
+#include "http_server.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+
+// ============================================================================
+// WebSocket Server Support (RFC 6455 on top of the HTTP connections)
+// ============================================================================
+//
+// A WebSocket starts as an ordinary GET with "Upgrade: websocket". The
+// handler creates a WebSocketSession, sets its callbacks and calls accept(),
+// after which the connection stops parsing HTTP and its input goes to the
+// session.
+
+// Client messages are small control requests; anything larger is refused
+constexpr size_t kMaxWebSocketMessage = 16 * 1024;
+
+/**
+ * @brief SHA-1, needed only for the Sec-WebSocket-Accept handshake value
+ */
+inline void sha1Digest(const std::string& input, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string data = input;
+    uint64_t bitLength = (uint64_t)input.size() * 8;
+    data += (char)0x80;
+    while (data.size() % 64 != 56) data += (char)0;
+    for (int i = 7; i >= 0; i--) data += (char)(bitLength >> (i * 8));
+
+    auto rotl = [](uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); };
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = (const unsigned char*)&data[block + i * 4];
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        }
+        for (int i = 16; i < 80; i++) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (unsigned char)(h[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(h[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(h[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)h[i];
+    }
+}
+
+inline std::string base64Encode(const unsigned char* data, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t chunk = (uint32_t)data[i] << 16;
+        if (i + 1 < size) chunk |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) chunk |= data[i + 2];
+        out += alphabet[(chunk >> 18) & 63];
+        out += alphabet[(chunk >> 12) & 63];
+        out += i + 1 < size ? alphabet[(chunk >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[chunk & 63] : '=';
+    }
+    return out;
+}
+
+/**
+ * @brief True if the request asks to switch to the WebSocket protocol
+ */
+inline bool isWebSocketUpgrade(const HttpRequest& request) {
+    std::string upgrade = request.header("upgrade");
+    std::string connection = request.header("connection");
+    for (auto& c : upgrade) c = (char)tolower((unsigned char)c);
+    for (auto& c : connection) c = (char)tolower((unsigned char)c);
+    return request.method == "GET" && upgrade == "websocket" &&
+           connection.find("upgrade") != std::string::npos &&
+           !request.header("sec-websocket-key").empty();
+}
+
+/**
+ * @brief The 101 Switching Protocols response for an upgrade request
+ */
+inline std::string webSocketHandshakeResponse(const HttpRequest& request) {
+    unsigned char digest[20];
+    sha1Digest(request.header("sec-websocket-key") + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    return "HTTP/1.1 101 Switching Protocols\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: " + base64Encode(digest, sizeof(digest)) + "\r\n\r\n";
+}
+
+/**
+ * @brief Builds an unmasked server-to-client frame
+ */
+inline std::string encodeWebSocketFrame(unsigned char opcode, const std::string& payload) {
+    std::string frame;
+    frame.reserve(payload.size() + 10);
+    frame += (char)(0x80 | opcode);  // FIN, no fragmentation
+    if (payload.size() < 126) {
+        frame += (char)payload.size();
+    } else if (payload.size() <= 0xFFFF) {
+        frame += (char)126;
+        frame += (char)(payload.size() >> 8);
+        frame += (char)payload.size();
+    } else {
+        frame += (char)127;
+        for (int i = 7; i >= 0; i--) frame += (char)((uint64_t)payload.size() >> (i * 8));
+    }
+    frame += payload;
+    return frame;
+}
+
+/**
+ * @brief One WebSocket client. Decodes incoming frames on the loop thread
+ * (answering pings and close requests itself) and sends text messages from
+ * any thread.
  */
+class WebSocketSession : public ProtocolHandler, public std::enable_shared_from_this<WebSocketSession> {
+public:
+    enum Opcode : unsigned char { Continuation = 0x0, Text = 0x1, Binary = 0x2, Close = 0x8, Ping = 0x9, Pong = 0xA };
+
+    explicit WebSocketSession(const std::shared_ptr<Connection>& connection)
+        : connection(connection) {}
+
+    /**
+     * @brief Called for each complete text message from the client
+     */
+    void setMessageHandler(std::function<void(const std::string&)> handler) {
+        onMessage = std::move(handler);
+    }
+
+    void setCloseHandler(std::function<void()> handler) {
+        onClose = std::move(handler);
+    }
+
+    /**
+     * @brief Completes the handshake; input is delivered from here on, so
+     * the callbacks must be set first.
+     */
+    void accept(const HttpRequest& request) {
+        if (auto client = connection.lock()) {
+            client->upgrade(webSocketHandshakeResponse(request), shared_from_this());
+        }
+    }
+
+    /**
+     * @brief Sends a text message. Returns false once the client is gone.
+     */
+    bool sendText(const std::string& text) {
+        auto client = connection.lock();
+        if (!client || !client->isOpen()) return false;
+        client->send(encodeWebSocketFrame(Text, text));
+        return true;
+    }
+
+    /**
+     * @brief Bytes handed to the connection but not yet on the wire, so
+     * publishers can skip slow clients instead of queueing without bound.
+     */
+    size_t pendingBytes() const {
+        auto client = connection.lock();
+        return client ? client->pendingBytes() : 0;
+    }
+
+    void onInput(std::string& input) override {
+        size_t pos = 0;
+        while (true) {
+            if (input.size() - pos < 2) break;
+            const unsigned char* p = (const unsigned char*)input.data() + pos;
+            bool fin = (p[0] & 0x80) != 0;
+            unsigned char opcode = p[0] & 0x0F;
+            bool masked = (p[1] & 0x80) != 0;
+            uint64_t length = p[1] & 0x7F;
+            size_t header = 2;
+            if (length == 126) {
+                if (input.size() - pos < 4) break;
+                length = (uint64_t)p[2] << 8 | p[3];
+                header = 4;
+            } else if (length == 127) {
+                if (input.size() - pos < 10) break;
+                length = 0;
+                for (int i = 0; i < 8; i++) length = length << 8 | p[2 + i];
+                header = 10;
+            }
+
+            // Clients must mask their frames (RFC 6455 5.1)
+            if (!masked || length > kMaxWebSocketMessage || message.size() + length > kMaxWebSocketMessage) {
+                fail(masked ? 1009 : 1002);
+                return;
+            }
+            if (input.size() - pos < header + 4 + length) break;
+
+            const unsigned char* mask = p + header;
+            std::string payload((const char*)p + header + 4, (size_t)length);
+            for (size_t i = 0; i < payload.size(); i++) payload[i] ^= (char)mask[i % 4];
+            pos += header + 4 + (size_t)length;
+
+            if (!handleFrame(fin, opcode, payload)) {
+                input.clear();
+                return;
+            }
+        }
+        input.erase(0, pos);
+    }
+
+    void onClosed() override {
+        if (onClose) onClose();
+    }
+
+private:
+    /**
+     * @brief Returns false once the session is closing
+     */
+    bool handleFrame(bool fin, unsigned char opcode, std::string& payload) {
+        auto client = connection.lock();
+        if (!client) return false;
+
+        switch (opcode) {
+            case Ping:
+                client->send(encodeWebSocketFrame(Pong, payload));
+                return true;
+            case Pong:
+                return true;
+            case Close:
+                client->send(encodeWebSocketFrame(Close, payload.substr(0, 2)));
+                client->close();
+                return false;
+            case Text:
+            case Binary:
+            case Continuation:
+                message += payload;
+                if (fin) {
+                    if (onMessage) onMessage(message);
+                    message.clear();
+                }
+                return true;
+            default:
+                fail(1002);
+                return false;
+        }
+    }
 
-#ifndef WEBSOCKETPP_SERVER_HPP
-#define WEBSOCKETPP_SERVER_HPP
+    void fail(int code) {
+        auto client = connection.lock();
+        if (!client) return;
+        std::string reason;
+        reason += (char)(code >> 8);
+        reason += (char)code;
+        client->send(encodeWebSocketFrame(Close, reason));
+        client->close();
+    }
 
-#include <websocketpp/roles/server_endpoint.hpp>
+    std::weak_ptr<Connection> connection;
+    std::function<void(const std::string&)> onMessage;
+    std::function<void()> onClose;
+    std::string message;
+};
 
-#endif //WEBSOCKETPP_SERVER_HPP
+#endif // DECLUTTER_WS_SERVER_HPP